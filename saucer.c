@@ -7,34 +7,139 @@
  *
  * Threads:
  *	one thread for keyboard control
+ *	one thread owning curses, outputting the screen once per frame
  *	one thread for each saucer
  *	one thread for each shot
  *	one thread for replacing saucers once they are finished
+ *	one thread waking saucer and shot threads from a timer wheel per tick
  * 	one thread for each time monitoring a possible last shot
+ *	with -A, one thread pressing the autopilot's keys
+ *
+ * Coroutine engine (saucer -c):
+ *	as the threaded engine, but each saucer and shot is a coroutine kept
+ *	in its record instead of a thread, resumed by a few scheduler threads
+ *	when the timer wheel has it due
+ *
+ * Tick engine (saucer -t):
+ *	one thread handling keys and moving the saucer and shot records that 
+ *	a timer wheel has due each tick
+ *	with -w, a fixed pool of workers moving the saucers of a share of 
+ *	the rows, then testing a share of the shots for hits, each step
  *
  * Mutex/Condition Variables:
- * 	drawing on the screen
+ * 	drawing on the screen, and handing out saucer and shot slots. saucer
+ *	and shot threads hold it shared to move, others exclusively
+ *	one for each saucer row, for the saucers' intervals on it
  *	replacing a thread
- *	updating the score
- * 	updating the number of shots
- *	calling for the program to exit
+ *	calling for the program to exit, and a shot thread finishing
+ *	the timer wheels of the threaded engine
+ *
+ * Atomics:
+ *	the score, rockets left and escaped saucers
+ *	the queue of draw commands for the render thread
  *
  * Compile:
  *	gcc saucer.c -lcurses -lpthread -o saucer
+ *	gcc -DSAUCER_LIBRARY -c saucer.c	without main, for programs that
+ *			play games through env_create, env_reset and env_step,
+ *			declared in saucer.h
+ *
+ * Usage:
+ *	saucer		one thread per saucer and shot
+ *	saucer -t	all saucers and shots advanced by a single tick loop
+ *	saucer -c n	threaded engine with saucers and shots as coroutines
+ *			run by n scheduler threads, 0 for one per core
+ *	saucer -w n	tick engine with n pooled workers, 0 for one per core.
+ *			not a win for an ordinary game: with fewer than 
+ *			POOLMIN saucers or shots due a step the work stays on
+ *			the tick thread, and sorting it into shares makes a 
+ *			step about twice as slow as without -w. it is for -X
+ *			with thousands of saucers and a core per worker
+ *	saucer -k n	tick engine with steps n ticks long, saucers and shots
+ *			moving up to n cells a step. hits are found by 
+ *			sweeping each move, but keys are handled and new 
+ *			saucers started once a step, so the same keys and 
+ *			seed play a different game for each n
+ *	saucer -f fps	output changes to the terminal fps times a second
+ *	saucer -b	tick engine testing every moving rocket against the 
+ *			saucers of its rows in one batch a step, with AVX2 
+ *			or SSE2 when the CPU has them
+ *	saucer -B	time the batch hit test against testing each rocket
+ *	saucer -C	check that timer wheels bring timers due at their tick,
+ *			however far ahead, and that headless games end as they
+ *			always have, with and without -w, -k, -b, -I and -E,
+ *			exiting with 1 if any do not
+ *	saucer -M file	time the saucer and shot moves, find_hit, saucer_hit 
+ *			and stats on in-memory screens of several sizes with 
+ *			several numbers of saucers and shots, writing JSON to
+ *			a file, or - for the standard output
+ *	saucer -a	output with ANSI codes instead of curses, writing only 
+ *			the cells changed since the last frame
+ *	saucer -H	headless: no terminal or sleeping, reports throughput
+ *	  -n ticks	  number of ticks to run, 100000 by default
+ *	  -s RxC	  size of the in-memory screen, 24x80 by default
+ *	saucer -r file	record the seed and every key pressed to a file
+ *	saucer -R file	replay a recording in real time, or with -H as fast as
+ *			possible. replays are exact with the tick engine 
+ *			without -w, where keys are handled between ticks
+ *	saucer -I n[xt]	run n headless games at once, each on one of t threads,
+ *			one per core by default, each pinned to a core. 
+ *			reports games finished a second and how long each 
+ *			game's steps took. -n, -s, -k and -X work as with -H
+ *	saucer -E n[xt]	play n games through env_step with random actions, on
+ *			t threads, 1 by default, each with its share of the
+ *			games. reports game steps a second. -n, -s and -k 
+ *			work as with -H
+ *	saucer -X nxr[xs] stress: headless with n saucers always in play on r
+ *			rows, and s rockets fired every tick, 1 by default,
+ *			with no end to the game or the rockets. reports the 
+ *			tick rate, step times and memory used. -n, -s, -w and
+ *			-k work as with -H
+ *	saucer -A n	autopilot: keys are pressed by a bot aiming at the 
+ *			saucers, in play or with -H, -I and -X in place of
+ *			the headless player. aggression n also fires blind,
+ *			every SHOTTICKS ticks at 1 and n-1 rockets a tick 
+ *			above that, 0 for only aimed rockets
+ *	saucer -S file	time every wait for and hold of the draw, replace, 
+ *			end and timer mutexes, draw's shared holds apart, each
+ *			frame and each tick, count the bytes output each 
+ *			frame, and write percentiles to a file on exit or on
+ *			SIGUSR1
+ *	saucer -T file	trace saucer spawns, moves, hits and escapes, shots 
+ *			fired, stepped and hitting, waits for the draw lock 
+ *			and each frame's output, and write them on exit as 
+ *			Chrome trace events, to open in Perfetto
  *	
  */
 
+/* for pinning threads to cores, see runner_thread */
+#define _GNU_SOURCE
+
 #include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
 #include <curses.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sched.h>
 #include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include "saucer.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 #include <sys/time.h>
 #include <sys/resource.h>
 
-/* the maximum number of rows with saucers on them */
-/* RESTRICTION: cannot be > LINES - 3 		   */
+/* the number of rows with saucers on them, unless set by -X */
+/* RESTRICTION: cannot be > LINES - 3 		   	  */
 #define NUMROW 3
 
 /* number of initial saucers to display at the start of the program */
@@ -42,7 +147,11 @@
 
 /* the maximum number of saucers on screen at one time 	*/
 /* RESTRICTION: must be >= NUMSAUCERS 			*/
+/* can be raised at compile time with -DMAXSAUCERS=n	*/
+/* saucer slots start with this many and grow if needed */
+#ifndef MAXSAUCERS
 #define MAXSAUCERS 6
+#endif
 
 /* the maximum number of escaped saucers */
 #define MAXESCAPE 20
@@ -57,13 +166,79 @@
 #define	SAUCERSPEED 20000
 
 /* delay of the shots, higher number = slower shots. 60000 recomended 	  */
-/* RESTRICTION: be sure to adjust MAXSHOTS to a higher number if changing */
-/* SHOTSPEED to be very fast 						  */
 #define SHOTSPEED 60000
 
-/* the maximum number of shot threads. 50 recomended for average window size */
-/* RESTRICTION: if the window size is very large be sure to increase this #! */
+/* the number of shot slots to start with. more are added when needed */
+#ifndef MAXSHOTS
 #define MAXSHOTS 100
+#endif
+
+/* command line options */
+#define USAGE "usage: saucer [-t] [-w workers] [-k scale] [-b] [-c threads] " \
+	"[-f fps] [-a] [-H | -X saucersxrows[xshots]] [-I games[xthreads]] " \
+	"[-E games[xthreads]] [-A aggression] " \
+	"[-n ticks] [-s rowsxcols] " \
+	"[-r file | -R file] [-S file] [-T file] | -B | -C | -M file\n"
+
+/* the status line at the bottom of the screen */
+#define STATUS \
+	" score: %d, rockets remaining: %d, escaped saucers: %d/%d        "
+
+/* number of times per second changes are output to the terminal */
+#define FRAMERATE 60
+
+/* length of one tick of the tick engine in microseconds */
+/* a saucer moves every (delay) ticks, a shot every SHOTTICKS ticks */
+#define TICK SAUCERSPEED
+#define SHOTTICKS (SHOTSPEED / TICK)
+
+/* timer wheel: slots per level as a power of 2, and number of levels */
+/* the top level reaches 2^(WHEELBITS*WHEELLEVELS) ticks ahead	      */
+/* RESTRICTION: WHEELBITS must be <= 6, see struct wheel	      */
+#define WHEELBITS 6
+#define WHEELSIZE (1 << WHEELBITS)
+#define WHEELLEVELS 3
+
+/* 
+ * one timer on a timer wheel, kept in its slot's circular list. in the 
+ * threaded engine the saucer or shot thread waits on wake until it is due
+ */
+struct timer{
+	struct timer *next;
+	struct timer *prev;
+	
+	/* wheel tick it is due at, and the saucer or shot record it is for */
+	long due;
+	void *owner;
+	sem_t wake;
+};
+
+/* 
+ * a hierarchical timer wheel: level 0 has a slot for each of the next 
+ * WHEELSIZE ticks and each slot of a higher level covers a whole turn of 
+ * the level below. slot heads point to themselves when empty. a bit of 
+ * busy is set for each slot a timer has been put in since it was last 
+ * emptied, so wheel_advance never reads the heads of empty slots
+ */
+struct wheel{
+	long now;
+	uint64_t busy[WHEELLEVELS];
+	struct timer slots[WHEELLEVELS][WHEELSIZE];
+};
+
+/* 
+ * stackless coroutines for the coroutine engine. a coroutine is a function
+ * of a saucer or shot record whose resume field says where it carries on 
+ * from, 0 at the start. CO_SLEEP saves the line it is on, puts the record's
+ * timer on a wheel and returns, and when the wheel has it due a scheduler 
+ * thread calls it again and CO_BEGIN jumps back to that line. locals are 
+ * not kept across a CO_SLEEP, and nothing may touch the record after one,
+ * as it can be resumed on another thread as soon as its timer is set
+ */
+#define CO_BEGIN(info) switch((info)->resume){ case 0:
+#define CO_SLEEP(info, w, due) do{ (info)->resume = __LINE__; \
+	timer_set((w), &(info)->timer, (due)); return; case __LINE__:; }while(0)
+#define CO_END }
 
 struct saucerprop{
 	int row;	
@@ -73,86 +248,853 @@ struct saucerprop{
 	/* element # in thread array */
 	int index;
 	
-	/* 0 default, set to 1 for kill */	
-	int kill;
+	/* 0 default, set to 1 for kill. atomic, as the threaded engine */
+	/* sets it under a row lock and the saucer's thread reads it    */
+	atomic_int kill;
+	
+	/* current column and number of characters still on screen */
+	int col;
+	int len;
+	
+	/* position of its interval in spans[row], -1 before its first move */
+	int span;
+	
+	/* wheel tick it was started at, and ticks between moves of step */
+	/* columns. where it was at any tick follows, see saucer_reach   */
+	long born;
+	int period;
+	int step;
+	
+	/* 1 while in play */
+	int alive;
+	
+	/* when it next moves */
+	struct timer timer;
+	
+	/* threaded engine: the thread last run for this slot. has_thread */
+	/* is cleared under draw before thread is written again, see main */
+	pthread_t thread;
+	atomic_int has_thread;
+	
+	/* coroutine engine: where saucer_co carries on from */
+	int resume;
 };
 
 struct shotprop{
 	int col;	
 	int row;
+	
+	/* slot index */
+	int index;
+	
+	/* 1 while in flight */
+	int alive;
+	
+	/* ticks between moves of step rows, and the tick it last moved at */
+	int period;
+	int step;
+	long moved;
+	
+	/* after a hit: the ticks it was on the row of the hit, see shot_move */
+	long from;
+	long to;
+	
+	/* when it next moves */
+	struct timer timer;
+	
+	/* threaded engine: the thread last run for this slot, as above */
+	pthread_t thread;
+	atomic_int has_thread;
+	
+	/* coroutine engine: where shot_co carries on from */
+	int resume;
+};
+
+/* records per chunk of a slot pool, chunks per block of its table of */
+/* chunks, and most blocks, so most chunks, in one pool		      */
+#define CHUNK 64
+#define CHUNKBLOCK 128
+#define MAXBLOCKS 128
+#define MAXCHUNKS (CHUNKBLOCK * MAXBLOCKS)
+
+/* histogram of times: buckets per power of 2 as a power of 2, and buckets */
+/* needed for any 64-bit value, see hist_record			       */
+#define HISTBITS 4
+#define HISTSUB (1 << HISTBITS)
+#define HISTBUCKETS ((64 - HISTBITS + 1) << HISTBITS)
+
+/* trace events in a chunk of a thread's trace, and most kept in all */
+#define TRACECHUNK 512
+#define TRACEMAX (1 << 22)
+
+/* kinds of draw command: some text, or the status line */
+#define DRAW_TEXT 0
+#define DRAW_STATUS 1
+
+/* characters of text carried by one draw command */
+#define CMDTEXT 24
+
+/* a terminal resize is passed to the game as a key holding the new size */
+#define KEY_SIZE 0x40000000
+#define SIZE_KEY(rows, cols) (KEY_SIZE | (rows) << 15 | (cols))
+#define IS_SIZE_KEY(c) ((c) > 0 && ((c) & KEY_SIZE))
+#define SIZE_ROWS(c) (((c) >> 15) & 0x7fff)
+#define SIZE_COLS(c) ((c) & 0x7fff)
+
+/* slots in the draw queue and key queue, the draw queue a power of two */
+#define DRAWQUEUE 4096
+#define KEYQUEUE 64
+
+/* fewest due saucers or hit tests worth handing to the worker pool */
+#define POOLMIN 64
+
+/* what a saucer did in the part of a pooled step run by a worker */
+#define SAUCER_SKIPPED 0
+#define SAUCER_MOVED 1
+#define SAUCER_CLEARED 2
+#define SAUCER_ESCAPED 3
+
+/* most keys the autopilot presses in one tick, and the most it leaves */
+/* queued, so the rest of the key queue is kept for the player's keys */
+#define AUTOKEYS (KEYQUEUE / 2)
+
+/* most pieces writev takes at once, if limits.h does not say */
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* a change to the screen queued for the render thread */
+struct drawcmd{
+	int op;
+	short row;
+	short col;
+	short len;
+	short colour;
+	
+	/* DRAW_TEXT */
+	char text[CMDTEXT];
+	
+	/* DRAW_STATUS: a snapshot of the counters */
+	int score;
+	int rockets;
+	int escaped;
+};
+
+/* one slot of the draw queue, seq says whether it is free or published */
+struct drawslot{
+	atomic_size_t seq;
+	struct drawcmd cmd;
+};
+
+/* lock-free queue of draw commands, many producers and one consumer */
+struct drawqueue{
+	struct drawslot *slots;
+	atomic_size_t head;
+	size_t tail;
+};
+
+/* log-linear histogram of times in nanoseconds, like an HDR histogram. */
+/* atomic, as stats_write reads it while other threads record	       */
+struct histogram{
+	atomic_long count;
+	atomic_long total;
+	atomic_long max;
+	atomic_long buckets[HISTBUCKETS];
+};
+
+/* a trace event: an instant if dur is -1, arg a slot index or -1 */
+struct traceevent{
+	long ts;
+	long dur;
+	const char *name;
+	int arg;
+};
+
+/* 
+ * one thread's trace, a list of chunks only that thread adds to. a chunk's
+ * n and a trace's chunks are published last, so trace_write can read them
+ * while the thread is still tracing
+ */
+struct tracechunk{
+	struct tracechunk *_Atomic next;
+	atomic_int n;
+	struct traceevent events[TRACECHUNK];
+};
+
+struct trace{
+	int tid;
+	struct tracechunk *_Atomic first;
+	struct tracechunk *last;
+	struct trace *next;
+};
+
+/* a mutex, or a read-write lock taken for writing, whose wait and hold */
+/* times are recorded when timing					 */
+struct timedlock{
+	char *name;
+	pthread_mutex_t *mutex;
+	pthread_rwlock_t *rwlock;
+	
+	/* when the holder acquired it */
+	long acquired;
+	
+	struct histogram wait;
+	struct histogram hold;
+	
+	/* a rwlock's shared holds, timed apart from the exclusive ones */
+	struct histogram shared_wait;
+	struct histogram shared_hold;
+};
+
+/* 
+ * the terminal as the ANSI renderer sees it: a character and colour pair 
+ * per cell for what it shows now, and for what it should show after this
+ * frame, plus the output of the frame being built
+ */
+struct ansiscreen{
+	int rows;
+	int cols;
+	char *front;
+	char *back;
+	unsigned char *front_colour;
+	unsigned char *back_colour;
+	
+	/* bytes of the frame, and one piece of it per row that changed */
+	char *out;
+	size_t len;
+	size_t cap;
+	struct iovec *iov;
+};
+
+/* 
+ * the hit tests of the rockets moving in a step of the tick engine, made 
+ * at once by hits_batch. each rocket has a test for every row it sweeps,
+ * see shot_window, and counts[i] is how many saucers test i found
+ */
+struct hitbatch{
+	
+	/* the rockets, and where each one's tests start */
+	struct shotprop **shots;
+	int *first;
+	int nshots;
+	int shotcap;
+	
+	/* the tests, and their order sorted by row and window */
+	int *rows;
+	int *cols;
+	long *from;
+	long *to;
+	int *counts;
+	int *order;
+	int ntests;
+	int testcap;
+	
+	/* the columns each saucer in a row covered during one window, as */
+	/* int16 padded to a multiple of 16, and the columns tested there */
+	int16_t *lo;
+	int16_t *hi;
+	int16_t *probe;
+	int *found;
+	int spancap;
+};
+
+/* keys read by the render thread waiting to be handled */
+struct keyqueue{
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	int keys[KEYQUEUE];
+	long head;
+	long tail;
+};
+
+/* recording modes, and size of the recording header */
+#define REC_WRITE 1
+#define REC_REPLAY 2
+#define RECHEADER 16
+
+/* 
+ * a recording is a 16 byte header: "SAUC", version 3, 1 if times are ticks 
+ * or 0 if microseconds, then little endian 16 bit rows and cols, 32 bit 
+ * seed (see game_seed) and 16 bit ticks a step (see -k). then one event 
+ * per key: the gap in time since the previous event and the key, both as 
+ * varints (see put_varint)
+ */
+struct recording{
+	FILE *file;
+	int mode;
+	
+	/* from the header */
+	int ticks;
+	int rows;
+	int cols;
+	unsigned seed;
+	int scale;
+	
+	/* when the game started, and time of the last event read or written */
+	struct timespec start;
+	long last;
+	
+	/* replay: the next event, and 1 if it has been read but not used */
+	long next;
+	int key;
+	int ready;
+};
+
+/* a unit of work run by the worker pool */
+struct task{
+	void (*run)(void *);
+	void *arg;
+};
+
+/* ring of tasks pushed to one worker, taken newest first by it and */
+/* oldest first by another worker stealing			    */
+struct deque{
+	pthread_mutex_t lock;
+	struct task *tasks;
+	
+	/* size is a power of two, top <= bottom index into the ring */
+	int size;
+	long top;
+	long bottom;
+};
+
+/* fixed set of worker threads that run saucer and shot updates */
+struct pool{
+	
+	/* number of workers, 0 when the pool is not in use */
+	int n;
+	pthread_t *threads;
+	struct deque *queues;
+	
+	/* next deque to push to, tasks in deques, tasks not yet finished */
+	atomic_int next;
+	atomic_int queued;
+	atomic_int pending;
+	
+	/* workers sleep on work, pool_wait sleeps on done */
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+};
+
+/* 
+ * the saucers on one row as intervals of the columns they cover, sorted by
+ * first column. kept as separate arrays so a hit test scans only columns
+ */
+struct rowspans{
+	int n;
+	int cap;
+	int *first;
+	int *last;
+	int *id;
+};
+
+/* 
+ * a xoshiro128** random number generator: 128 bits of state, seeded from
+ * a seed and a stream number by rng_seed so each stream of a seed differs
+ */
+struct rng{
+	uint32_t s[4];
+};
+
+/* the records and generations of CHUNKBLOCK chunks of a slot pool */
+struct chunkblock{
+	void *records[CHUNKBLOCK];
+	atomic_uint *gens[CHUNKBLOCK];
+};
+
+/* 
+ * pool of records handed out by slot index. records are kept in chunks of 
+ * CHUNK that never move, and free slots on a stack. each slot has a 
+ * generation that goes up when it is freed, see slot_handle. the table of
+ * chunks is in blocks allocated as the pool grows into them, which never 
+ * move either, so a game starts with a few KB of table and not the most
+ * it could ever need
+ */
+struct slots{
+	
+	/* bytes per record, slots allocated, one past the highest used */
+	size_t size;
+	int cap;
+	int used;
+	
+	struct chunkblock *blocks[MAXBLOCKS];
+	
+	/* stack of free slot indices */
+	int *free;
+	int nfree;
+};
+
+/* 
+ * one game: everything that changes as it is played. main plays main_game,
+ * the runner (see -I) plays many games at once, each on one thread at a 
+ * time. functions play the game the calling thread's game points to
+ */
+struct game{
+	
+	/* for storing the properties of saucers and shots */
+	struct slots saucer_slots;
+	struct slots shot_slots;
+	
+	/* collision detection: the saucers on each row. shots are only */
+	/* ever tested against these, so nothing is kept per cell	 */
+	struct rowspans *spans;
+	
+	/* score update variables */
+	/* atomic so firing and scoring never wait on each other */
+	atomic_int escape_update;
+	atomic_int shot_update;
+	atomic_int score_update;
+	
+	/* holds the element number of the thread that can be replaced */
+	int replace_index;
+	
+	/* handle of the most up to date shot */
+	_Atomic uint64_t last_shot;
+	
+	/* colour of the next saucer */
+	int next_colour;
+	
+	/* the rockets tested at once by hits_batch, or by the pool */
+	struct hitbatch batch;
+	
+	/* the pooled tick engine: the saucers due in a step in wheel order, */
+	/* what each did (SAUCER_MOVED etc.), their numbers sorted by row,   */
+	/* and where each row's start there, see tick_pooled		     */
+	struct saucerprop **due;
+	int *done;
+	int *byrow;
+	int *rowstart;
+	int ndue;
+	int duecap;
+	
+	/* ticks run by the tick engine since the game started */
+	long tick_count;
+	
+	/* set during a tick: the game has ended */
+	int game_over;
+	
+	/* when each saucer and shot next moves. the tick engine uses them */
+	/* under the draw lock, the threaded engine under timer_mutex	    */
+	struct wheel saucer_wheel;
+	struct wheel shot_wheel;
+	
+	/* size of the screen the game is played on. it follows LINES and */
+	/* COLS but only changes under the draw lock, see screen_resize   */
+	int screen_rows;
+	int screen_cols;
+	
+	/* headless: the screen drawn into instead, rows*cols chars */
+	char *screen_buf;
+	
+	/* totals of saucer and shot moves and of saucers hit, for headless */
+	long updates;
+	long collisions;
+	
+	/* launch site column, number of saucers started, and the key */
+	/* bench_player moves the launch site with, the column atomic */
+	/* as the autopilot thread reads it while keys are handled    */
+	atomic_int launch_position;
+	int nsaucers;
+	int player_direction;
+	
+	/* handle of the saucer the autopilot last fired an aimed rocket at */
+	uint64_t auto_target;
+	
+	/* random numbers: roll for the spawn check, only used by the thread */
+	/* handling keys, and setup for new saucers, only used under draw    */
+	struct rng roll;
+	struct rng setup;
+	
+	/* drawing on the screen, and handing out saucer and shot slots, */
+	/* then the stripes of the collision index: one mutex per row.   */
+	/* draw prefers writers, so the threads holding it shared to move */
+	/* can not keep out firing, replacing, pausing and resizing	  */
+	pthread_rwlock_t draw;
+	struct timedlock draw_timing;
+	pthread_mutex_t *row_mutex;
+	struct timedlock *row_timing;
+	
+	/* how long each step of the tick engine took */
+	struct histogram tick_hist;
+	
+	/* runner: games finished and ticks run */
+	int games;
+	long ticks;
+	
+	/* 1 if played by the tick engine, and 1 if drawn into screen_buf, */
+	/* main_game as the options say, games of -I and env_create always */
+	int tick_engine;
+	int headless;
 };
 
-struct screen{
-	int shot;
-	int saucer;
-	int here[MAXSAUCERS];
+/* the game main plays, and the one the calling thread is playing */
+struct game main_game = {
+	.saucer_slots = {.size = sizeof(struct saucerprop)},
+	.shot_slots = {.size = sizeof(struct shotprop)},
+	.shot_update = NUMSHOTS,
+	.player_direction = '.',
+	.draw = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP,
+	.draw_timing = {.name = "draw", .rwlock = &main_game.draw}
 };
+_Thread_local struct game *game = &main_game;
+
+/* when the calling thread last took draw shared, for -S */
+_Thread_local long shared_acquired;
 
-/* for storing the properties of saucers and shots */
-struct saucerprop saucerinfo[MAXSAUCERS];
-struct shotprop shotinfo[MAXSHOTS];
+/* rows saucers fly on, saucers in play at the start of a game, and the */
+/* rockets it starts with. -X raises them				*/
+int saucer_rows = NUMROW;
+int start_saucers = NUMSAUCERS;
+int start_rockets = NUMSHOTS;
 
-/* collision detection array */
-struct screen **collision_position;
+/* games played at once by the runner on runner_threads threads for */
+/* runner_ticks ticks each, see -I				      */
+int instances;
+int runner_threads;
+long runner_ticks;
+struct game *instance;
 
-/* score update variables */		
-int escape_update = 0;
-int shot_update = NUMSHOTS;
-int score_update = 0;
+/* 1 if a bot presses the keys, firing blind more the higher aggression */
+int autopilot;
+int aggression;
 
-/* holds the element number of the thread that can be replaced */
-int replace_index;
+/* games played by env_bench on env_threads threads, see -E */
+int env_games;
+int env_threads;
 
-/* saves the most up to date shot index */
-int save;
+/* 1 for a stress run, see -X, with stress_shots rockets fired a tick */
+int stress;
+int stress_shots = 1;
 
-/* screen colour variables */
+/* the most saucers on screen at one time, starts at MAXSAUCERS */
+int max_saucers = MAXSAUCERS;
+
+/* screen colour variable */
 int use_colour;
-int next_colour;
+
+/* 1 if saucers and shots are records advanced by tick_loop, not threads */
+/* main_game's setting, copied to it by main, see struct game	      */
+int tick_engine;
+
+/* 1 if saucers and shots are coroutines run on the worker pool, see -c */
+int coroutines;
+
+/* worker pool for the tick engine, n stays 0 unless saucer -w is used */
+/* the coroutine engine's scheduler threads are its workers too	      */
+struct pool pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
+/* frames per second output by render_loop, set by main to stop it */
+int frame_rate = FRAMERATE;
+atomic_int render_stop;
+
+/* draw commands and keys passed to and from the render thread */
+struct drawqueue draws;
+struct keyqueue keys = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.ready = PTHREAD_COND_INITIALIZER
+};
+
+/* 1 to output frames with ANSI codes instead of curses, see ansi_frame */
+int ansi;
+struct ansiscreen term;
+
+/* SGR codes for the colour pairs set up in main, 0 for the default */
+char *sgr_codes[] = {
+	"\033[0m", "\033[31;40m", "\033[32;40m", "\033[34;40m", 
+	"\033[36;40m", "\033[35;40m", "\033[33;40m"
+};
+
+/* screen sizes and numbers of saucers and shots timed by micro_bench, */
+/* and how long to time each case for, in nanoseconds		      */
+#define MICROSIZES {{24, 80}, {60, 200}, {200, 400}}
+#define MICROCOUNTS {8, 128, 2048}
+#define MICROTIME 20000000L
+
+/* how many ticks ahead check_wheel schedules its timers, each again */
+/* as often once due, and how many ticks it runs for		    */
+#define CHECKPERIODS {1, 63, 64, 100, 128, 4095, 4096, 4100}
+#define CHECKTICKS (5 * 4100)
+
+/* the headless runs check_headless makes, and two numbers each must print */
+/* with the default settings: the text before each then what should follow */
+#define CHECKRUNS { \
+	{"-H -n 300000", {"games: ", "collisions: "}, {1743, 5784}}, \
+	{"-H -n 300000 -w 2", {"games: ", "collisions: "}, {1743, 5784}}, \
+	{"-H -n 300000 -k 6", {"games: ", "collisions: "}, {1738, 5775}}, \
+	{"-H -n 300000 -b", {"games: ", "collisions: "}, {1743, 5784}}, \
+	{"-H -I 16x2 -n 20000", {"games finished: ", "collisions: "}, \
+	    {1835, 6125}}, \
+	{"-H -E 64x2 -n 2000", {"reward: ", "games ended: "}, {623, 809}}, \
+	{NULL, {NULL, NULL}, {0, 0}} \
+}
+
+/* 1 to test rockets in batches with hits_kernel, see -b */
+int batch_hits;
+void (*hits_kernel)();
+
+/* the case micro_bench is timing: saucers and shots in play, and the */
+/* positions find_hit is tested at				      */
+int micro_count;
+int *micro_cols;
+
+/* keys being recorded or replayed, mode is 0 for neither */
+struct recording rec;
+
+/* ticks the tick engine runs at once in a step, see -k */
+int tick_scale = 1;
+
+/* colour pair this thread is drawing with, 0 for the default */
+_Thread_local int draw_colour;
+
+/* 1 to draw into screen_buf instead of the terminal, for main_game */
+int headless;
+
+/* saucer shapes: full, erased, and without the leading padding */
+char *saucer_shape = " <--->";
+char *saucer_blank = "      ";
+char *saucer_trim = "<--->";
 
 /* condition variables */
 pthread_cond_t replace_condition = PTHREAD_COND_INITIALIZER;
 pthread_cond_t end_condition = PTHREAD_COND_INITIALIZER;
+pthread_cond_t shot_done = PTHREAD_COND_INITIALIZER;
 
-/* mutexes */
-pthread_mutex_t draw = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t score_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t shot_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* mutexes, the draw lock is each game's own */
 pthread_mutex_t replace_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t end_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t timer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* the mutexes above, timed with lock_timed and unlock_timed */
+struct timedlock replace_timing = {.name = "replace", .mutex = &replace_mutex};
+struct timedlock end_timing = {.name = "end", .mutex = &end_mutex};
+struct timedlock timer_timing = {.name = "timer", .mutex = &timer_mutex};
+struct timedlock *timed_locks[] = {
+	&main_game.draw_timing, &replace_timing, &end_timing, &timer_timing, 
+	NULL
+};
+
+/* 1 to record lock, frame and tick times, written to stats_path on exit */
+/* or when SIGUSR1 sets stats_requested				 */
+int timing;
+char *stats_path;
+atomic_int stats_requested;
+struct histogram frame_hist;
+struct histogram bytes_hist;
+
+/* 1 to trace events, written to trace_path on exit. every thread that */
+/* traces has its own trace, all in the list at traces		       */
+int tracing;
+char *trace_path;
+long trace_start;
+_Thread_local struct trace *trace_own;
+struct trace *_Atomic traces;
+atomic_int trace_threads;
+atomic_long trace_events;
+atomic_long trace_dropped;
 
 /* arrays to store the threads */
-pthread_t saucer_t[MAXSAUCERS];
-pthread_t shot_t[MAXSHOTS];
 pthread_t end_t;
+pthread_t wake_t;
+pthread_t tick_t;
+pthread_t render_t;
+pthread_t auto_t;
 
 /* function prototypes */
 void lock_draw();
 void unlock_draw();
+void lock_draw_shared();
+void unlock_draw_shared();
+void lock_row();
+void unlock_row();
+long now_ns();
+void hist_record();
+long hist_value();
+void lock_timed();
+void unlock_timed();
+void mutex_cleanup();
+void cond_wait();
+void wait_timed();
+long trace_now();
+void trace_event();
+void trace_span();
+void trace_write();
+void hist_print();
+void stats_write();
+void stats_signal();
+void stats_poll();
+void sleep_until();
+void draw_start();
+void draw_push();
+int draw_pop();
+void draw_apply();
+void key_push();
+void put_varint();
+int get_varint();
+int rec_open();
+void seed_game();
+long rec_time();
+void rec_key();
+void rec_peek();
+int key_pop();
+int replay_quit();
+int read_key();
+int poll_key();
+long thread_written();
+void ansi_resize();
+void ansi_put();
+void ansi_apply();
+long ansi_frame();
+void render_frame();
+void *render_loop();
+void scr_addnstr();
+void scr_addch();
+void scr_printw(int row, int col, const char *format, ...);
+void scr_colour();
+void screen_resize();
+int slots_grow();
+void slots_init();
+int slot_alloc();
+void slot_free();
+void slots_clear();
+void *slot_get();
+atomic_uint *slot_gen();
+uint64_t slot_handle();
+int slot_valid();
+struct saucerprop *saucer_at();
+struct shotprop *shot_at();
+int saucer_alloc();
+void rng_seed();
+uint32_t rng_next();
+int rng_below();
+void game_seed();
 void setup_saucer();
+void draw_stats();
 void stats();
 int launch_site();
+void clear_saucer();
 void saucer_hit();
-void new_saucer_position();
+void span_swap();
+int span_find();
+void span_insert();
+void span_remove();
+void span_move();
+int span_count();
+void spans_clear();
+void spans_init();
+int saucer_move();
+int saucer_escape();
 void *saucers();
+void saucer_co();
+void saucer_restart();
+void start_saucer();
 int rand_saucers();
 void *replace_thread();
+void wheel_init();
+void wheel_insert();
+void timer_remove();
+void wheel_at();
+void wheel_add();
+long wheel_now();
+struct timer *wheel_window();
+struct timer *wheel_advance();
+void timer_set();
+void timer_sleep();
+void *timer_thread();
+int saucer_reach();
+int sweep_hits();
+int mark_hits();
+void hits_scalar();
+void hits_sse2();
+void hits_avx2();
+void (*hits_pick())();
+void batch_grow();
+void batch_tests();
+int batch_compare();
+int hits_reach();
+void hits_batch();
+void hits_bench();
+int shot_rows();
+void shot_window();
+void add_hits();
+int reserve_rocket();
 void find_hit();
+int shot_move();
 void *shots();
+void shot_co();
+void shot_finish();
 void *find_end();
-int fire_shot();
+void tick_fire_shot();
+void shot_schedule();
+void fire_shot();
+void deque_push();
+int deque_take();
+void *worker();
+void pool_start();
+void pool_push();
+void pool_wait();
+int saucer_advance();
+int saucer_settle();
+int saucer_tick();
+void saucer_replace();
+void shot_tick();
+void due_grow();
+void saucer_work();
+void shot_work();
+void tick_shares();
+void tick_pooled();
+int tick_step();
+void *tick_loop();
+void game_start();
+int handle_key();
 void *process_input();
+void game_reset();
+void bench_player();
+int autopilot_keys();
+void autopilot_play();
+void *autopilot_thread();
+void headless_player();
+void stress_player();
+void stress_report();
+void headless_run();
+void game_init();
+void *env_thread();
+void env_bench();
+void *runner_thread();
+void runner_run();
+void micro_setup();
+void micro_saucer();
+void micro_shot();
+void micro_find();
+void micro_unkill();
+void micro_hit();
+void micro_unhit();
+void micro_stats();
+void micro_case();
+void micro_bench();
+int check_wheel();
+int check_headless();
+int self_check();
 int welcome(); 
 
 
+#ifndef SAUCER_LIBRARY
 /*
  * main does some simple error checking and setup as well as some closing tasks
  * when it gets a signal from other threads
- * expects no arguments
+ * expects the options listed at the top of the file (see USAGE), which pick
+ * the engine, the screen and a headless, stress, runner or benchmark mode
  */
 int main(int ac, char *av[]){
 	
 	int i, c, r_padding, c_padding;
+	int workers = 0;
+	int use_pool = 0;
+	int schedulers = 0;
 	void *retval;
 	
 	/* id for the thread that handles assigning replacements */
@@ -164,29 +1106,271 @@ int main(int ac, char *av[]){
 	/* for finding the maximum processes allowed at once on the computer */
 	struct rlimit rlim;
 	
-	/* for creating the 2D array used for collision detection */
-	struct screen **array;
-	struct screen *data;
+	/* headless screen size and number of ticks to run */
+	int rows = 24;
+	int cols = 80;
+	long ticks = 100000;
+	int ticks_set = 0;
+	
+	/* recording to write or replay */
+	char *record = NULL;
+	char *replay = NULL;
+	
+	/* where to write microbenchmark results */
+	char *micro = NULL;
 
-	/* no arguments should be included for this program */
-	if (ac != 1){
-		printf("usage: saucer\n");
+	/* -t selects the tick engine, -w also runs it on a worker pool */
+	/* -k makes each step of the tick engine run that many ticks */
+	/* -c runs saucers and shots as coroutines on scheduler threads */
+	/* -f sets how many frames per second are output */
+	/* -a outputs them with ANSI codes instead of curses */
+	/* -b tests rockets in batches, -B times doing so */
+	/* -C checks parts of the game, see self_check */
+	/* -M times the work done every tick and writes JSON to a file */
+	/* -H runs headless for -n ticks on a -s rowsxcols screen */
+	/* -r records the player's keys to a file, -R replays them */
+	/* -S times locks, frames and ticks and writes them to a file */
+	/* -T traces what every thread does and writes it to a file */
+	/* -I plays many headless games at once on a pinned thread each */
+	/* -E plays them through env_step instead */
+	/* -A has a bot press the keys */
+	while((c = getopt(ac, av, 
+	    "tw:k:bBCM:c:f:aHX:I:E:A:n:s:r:R:S:T:")) != -1){
+		if(c == 't'){
+			tick_engine = 1;
+		}
+		else if(c == 'w'){
+			tick_engine = 1;
+			workers = atoi(optarg);
+			use_pool = 1;
+		}
+		else if(c == 'k' && atoi(optarg) > 0 && atoi(optarg) <= 0xffff){
+			tick_engine = 1;
+			tick_scale = atoi(optarg);
+		}
+		else if(c == 'f' && atoi(optarg) > 0){
+			frame_rate = atoi(optarg);
+		}
+		else if(c == 'c'){
+			coroutines = 1;
+			schedulers = atoi(optarg);
+		}
+		else if(c == 'b'){
+			tick_engine = 1;
+			batch_hits = 1;
+		}
+		else if(c == 'B'){
+			hits_kernel = hits_pick();
+			hits_bench();
+			return 0;
+		}
+		else if(c == 'C'){
+			return self_check();
+		}
+		else if(c == 'M'){
+			micro = optarg;
+		}
+		else if(c == 'a'){
+			ansi = 1;
+		}
+		else if(c == 'H'){
+			headless = 1;
+		}
+		else if(c == 'n' && atol(optarg) > 0){
+			ticks = atol(optarg);
+			ticks_set = 1;
+		}
+		else if(c == 'r'){
+			record = optarg;
+		}
+		else if(c == 'R'){
+			replay = optarg;
+		}
+		else if(c == 'S'){
+			stats_path = optarg;
+			timing = 1;
+		}
+		else if(c == 'T'){
+			trace_path = optarg;
+			tracing = 1;
+		}
+		else if(c == 'X' && sscanf(optarg, "%dx%dx%d", &start_saucers,
+		    &saucer_rows, &stress_shots) >= 2 && start_saucers > 0 && 
+		    saucer_rows > 0 && stress_shots >= 0){
+			stress = 1;
+			headless = 1;
+		}
+		else if(c == 'I' && sscanf(optarg, "%dx%d", &instances, 
+		    &runner_threads) >= 1 && instances > 0 && 
+		    runner_threads >= 0){
+			headless = 1;
+		}
+		else if(c == 'E' && sscanf(optarg, "%dx%d", &env_games, 
+		    &env_threads) >= 1 && env_games > 0 && env_threads >= 0){
+			headless = 1;
+		}
+		else if(c == 'A' && atoi(optarg) >= 0){
+			autopilot = 1;
+			aggression = atoi(optarg);
+		}
+		else if(c == 's' && sscanf(optarg, "%dx%d", &rows, &cols) == 2 
+		    && rows > 0 && cols > 2 * (int)strlen(saucer_shape)){
+		}
+		else{
+			fprintf(stderr, USAGE);
+			exit(1);
+		}
+	}
+	if(optind != ac || (record && (replay || headless)) || 
+	    (stress && replay) || (autopilot && replay) || 
+	    ((instances || env_games) && 
+	    (replay || use_pool || timing || stress))){
+		fprintf(stderr, USAGE);
 		exit(1);
 	}
 	
-	/* make sure the system allows enough processes to play the game */
-	getrlimit(RLIMIT_NPROC, &rlim);
-	if (rlim.rlim_cur < MAXSAUCERS + MAXSHOTS + 4){
-		fprintf(stderr,
-		"Your system does not allow enough processes for this game\n");
-		exit(-1);
+	/* a stress run makes the screen tall enough for its rows, and keeps */
+	/* its saucers in play with rockets that never run out	    */
+	if(stress){
+		if(rows < saucer_rows + 3){
+			rows = saucer_rows + 3;
+		}
+		max_saucers = start_saucers;
+		start_rockets = INT_MAX / 2;
+		game->shot_update = start_rockets;
+	}
+	else if(rows < saucer_rows + 3){
+		fprintf(stderr, USAGE);
+		exit(1);
+	}
+	
+	/* a recording is replayed with the engine, step and size it was */
+	/* made with, as -k changes where in a step keys take effect     */
+	if(replay){
+		if(rec_open(replay, REC_REPLAY)){
+			fprintf(stderr, "%s: not a saucer recording\n", replay);
+			exit(1);
+		}
+		tick_engine = rec.ticks;
+		tick_scale = rec.scale;
+		rows = rec.rows;
+		cols = rec.cols;
+		if(headless && !tick_engine){
+			fprintf(stderr, "%s: recorded with the threaded "
+			    "engine, replay it without -H\n", replay);
+			exit(1);
+		}
+		
+		/* run to the end of the recording unless told otherwise */
+		if(!ticks_set){
+			ticks = LONG_MAX;
+		}
+	}
+	
+	/* coroutines replace the threads of the threaded engine only */
+	if(coroutines && (tick_engine || headless)){
+		fprintf(stderr, USAGE);
+		exit(1);
+	}
+	
+	/* headless games always run on the tick engine */
+	if(headless){
+		tick_engine = 1;
+	}
+	game->tick_engine = tick_engine;
+	game->headless = headless;
+	/* SIGUSR1 writes the stats file without stopping the game */
+	if(timing){
+		signal(SIGUSR1, stats_signal);
+	}
+	
+	/* the trace is written however the program ends */
+	if(tracing){
+		trace_start = now_ns();
+		atexit(trace_write);
+	}
+	if(record && rec_open(record, REC_WRITE)){
+		perror(record);
+		exit(1);
+	}
+	
+	/* the fastest batch hit test this CPU can run */
+	hits_kernel = hits_pick();
+	
+	/* saucer and shot slots start with room for MAXSAUCERS and MAXSHOTS */
+	/* and grow past them when more are in play at once */
+	slots_init(&game->saucer_slots, MAXSAUCERS);
+	slots_init(&game->shot_slots, MAXSHOTS);
+	wheel_init(&game->saucer_wheel);
+	wheel_init(&game->shot_wheel);
+	
+	/* the microbenchmarks set up their own rows and screens, and the */
+	/* runner's games each have their own */
+	if(micro){
+		micro_bench(micro);
+		return 0;
 	}
+	if(instances){
+		tick_engine = 1;
+		runner_run(instances, runner_threads, rows, cols, ticks);
+		return 0;
+	}
+	if(env_games){
+		env_bench(env_games, env_threads, rows, cols, ticks);
+		return 0;
+	}
+	spans_init();
+	
+	/* headless: the tick engine with no terminal, run as fast as it can */
+	if(headless){
+		tick_engine = 1;
+		game->screen_rows = rows;
+		game->screen_cols = cols;
+		game->screen_buf = malloc(rows * cols);
+		if(game->screen_buf == NULL){
+			fprintf(stderr, "malloc failed, maybe we ran out of "
+			    "memory\n");
+			exit(-1);
+		}
+		memset(game->screen_buf, ' ', rows * cols);
+		if(use_pool){
+			pool_start(workers);
+		}
+		headless_run(ticks);
+		return 0;
+	}
+	
+	/* the tick engine runs the same two threads however many entities */
+	if(!tick_engine){
+	
+		/* make sure the system allows enough processes for the game */
+		getrlimit(RLIMIT_NPROC, &rlim);
+		if (!coroutines && rlim.rlim_cur < MAXSAUCERS + MAXSHOTS + 5){
+			fprintf(stderr, "Your system does not allow enough "
+			    "processes for this game\n");
+			exit(-1);
+		}
+		
+		/* coroutines replace saucers themselves, on the scheduler */
+		/* threads, which have to be running before anything is due */
+		if(coroutines){
+			pool_start(schedulers);
+		}
 
-	/* create a new thread to handle the other threads */
-	if (pthread_create(&replace_t, NULL, replace_thread, NULL)){
-		/* if thread is not created exit */
-		fprintf(stderr,"error creating replacement control thread\n");
-		exit(-1);
+		/* create a new thread to handle the other threads */
+		else if (pthread_create(&replace_t, NULL, replace_thread, 
+		    NULL)){
+			/* if thread is not created exit */
+			fprintf(stderr,
+			    "error creating replacement control thread\n");
+			exit(-1);
+		}
+		
+		/* create a thread to wake saucer and shot threads when due */
+		if (pthread_create(&wake_t, NULL, timer_thread, NULL)){
+			fprintf(stderr,"error creating timer thread\n");
+			exit(-1);
+		}
 	}
 	
 	/* set up curses */
@@ -217,49 +1401,144 @@ int main(int ac, char *av[]){
 	/* print opening message with instructions */
 	welcome();
 	
-	/* found this section of code from http://bit.ly/19Px1R4 */
-	/* creates a 2D array */
-	array = calloc(LINES-1, sizeof(*array));
-	data = calloc((LINES-1) * (COLS-1), sizeof(*data));
+	/* the game is played at the size of the terminal, until it is   */
+	/* resized, and a replay at the size it was recorded at, in the  */
+	/* top left of the terminal. a recorded resize past the terminal */
+	/* is played in full but only drawn as far as the terminal goes  */
+	if(replay && (LINES < rows || COLS < cols)){
+		endwin();
+		fprintf(stderr, "%s: recorded on a %dx%d terminal, this one is "
+		    "%dx%d\n", replay, rows, cols, LINES, COLS);
+		exit(1);
+	}
+	game->screen_rows = replay ? rows : LINES;
+	game->screen_cols = replay ? cols : COLS;
+	
+	/* getch returns ERR straight away so the render thread never waits */
+	nodelay(stdscr, TRUE);
 	
-	/* error checking: calloc returns NULL if it failed */
-	if(array == NULL || data == NULL) {
-		fprintf(stderr, "calloc failed, maybe we ran out of memory \n");
+	/* create a thread that owns curses and outputs each frame */
+	draw_start();
+	if(ansi){
+		ansi_resize(LINES, COLS);
+	}
+	if (pthread_create(&render_t, NULL, render_loop, NULL)){
+		fprintf(stderr,"error creating render thread\n");
 		endwin();
 		exit(-1);
 	}
 	
-	/* connect the rows and cols, now we can use array[i][j] */
-	for(i = 0; i < (LINES-1); i++){
-		array[i] = &data[i * (COLS-1)];
+	/* the tick loop replaces the saucer, shot and replacement threads */
+	if(tick_engine){
+		if(use_pool){
+			pool_start(workers);
+		}
+		if (pthread_create(&tick_t, NULL, tick_loop, NULL)){
+			fprintf(stderr,"error creating tick thread\n");
+			endwin();
+			exit(-1);
+		}
 	}
-	/* end section from stackoverflow */
-	
-	/* collision_position is a global so any function can access array */
-	collision_position = array;
 	
 	/* create a thread for handling user input */
-	if (pthread_create(&input_t, NULL, process_input, NULL)){
+	/* the tick loop handles input itself between ticks */
+	if (!tick_engine && 
+	    pthread_create(&input_t, NULL, process_input, NULL)){
 		fprintf(stderr,"error creating input processing thread\n");
 		endwin();
 		exit(-1);
 	}
 	
-	/* wait for 'Q', too many escaped saucers, or run out of rockets */
-	/* score mutex is locked by the calling thread to ensure no updates */
-	pthread_mutex_lock(&end_mutex);
-	pthread_cond_wait(&end_condition, &end_mutex);
-	
-	/* cancel all threads so they no longer update */
-	for(i=0; i<MAXSAUCERS; i++){
-		pthread_cancel(saucer_t[i]);
+	/* and one pressing the autopilot's keys for it to read */
+	if (!tick_engine && autopilot && 
+	    pthread_create(&auto_t, NULL, autopilot_thread, NULL)){
+		fprintf(stderr,"error creating autopilot thread\n");
+		endwin();
+		exit(-1);
+	}
+	
+	/* wait for 'Q', too many escaped saucers, or run out of rockets */
+	/* the thread that ends the game takes end_mutex to signal, the */
+	/* counters are atomics and need no lock			*/
+	lock_timed(&end_timing);
+	wait_timed(&end_condition, &end_timing);
+	unlock_timed(&end_timing);
+	
+	/* cancel all threads so they no longer update */
+	/* cancelling an id of 0 crashes, so guard end_t */
+	if(tick_engine){
+		pthread_cancel(tick_t);
+		for(i=0; i<pool.n; i++){
+			pthread_cancel(pool.threads[i]);
+		}
+	}
+	else{
+	
+		/* the slots are read under draw, so no thread id is being */
+		/* written while its has_thread is still set		   */
+		lock_draw();
+		for(i=0; i<game->saucer_slots.used; i++){
+			if(saucer_at(i)->has_thread){
+				pthread_cancel(saucer_at(i)->thread);
+			}
+		}
+		for(i=0; i<game->shot_slots.used; i++){
+			if(shot_at(i)->has_thread){
+				pthread_cancel(shot_at(i)->thread);
+			}
+		}
+		unlock_draw();
+		for(i=0; i<pool.n; i++){
+			pthread_cancel(pool.threads[i]);
+		}
+		if(!coroutines){
+			pthread_cancel(replace_t);
+		}
+		pthread_cancel(wake_t);
+		if(end_t){
+			pthread_cancel(end_t);
+		}
+		pthread_cancel(input_t);
+		if(autopilot){
+			pthread_cancel(auto_t);
+		}
+	}
+	
+	/* wait for the threads that time locks and ticks to stop, so */
+	/* the stats are final. the saucer, shot and pool threads and */
+	/* find_end are left to stop at their next cancellation point */
+	if(tick_engine){
+		pthread_join(tick_t, &retval);
+	}
+	else{
+		if(!coroutines){
+			pthread_join(replace_t, &retval);
+		}
+		pthread_join(wake_t, &retval);
+		pthread_join(input_t, &retval);
+		if(autopilot){
+			pthread_join(auto_t, &retval);
+		}
+	}
+	
+	/* finish writing the recording */
+	if(rec.mode == REC_WRITE){
+		fclose(rec.file);
+	}
+	
+	/* wait for the render thread to output the last frame and hand back */
+	/* curses to this thread */
+	render_stop = 1;
+	pthread_join(render_t, &retval);
+	nodelay(stdscr, FALSE);
+	
+	/* curses does not know what the ANSI frames left on the terminal */
+	if(ansi){
+		clearok(curscr, TRUE);
 	}
-	for(i=0; i<MAXSHOTS; i++){
-		pthread_cancel(shot_t[i]);
+	if(timing){
+		stats_write();
 	}
-	pthread_cancel(replace_t);
-	pthread_cancel(input_t);
-	pthread_cancel(end_t);
 	
 	/* erase everything on the screen in prep for closing message */
 	erase();
@@ -269,31 +1548,30 @@ int main(int ac, char *av[]){
 	c_padding = COLS/2 - COLS/3;
 	
 	/* if the game ends by too many saucers escaping */
-	if(escape_update == MAXESCAPE){
+	if(game->escape_update >= MAXESCAPE){
 		
 		/* print too many escaped saucers closing message */
 		mvprintw(r_padding, c_padding, "TOO MANY SAUCERS ESCAPED :(");
 	}
 	
 	/* if the game ends by running out of shots */
-	else if(shot_update == 0){
+	else if(game->shot_update == 0){
 		
 		/* print ran out of rockets closing message */
 		mvprintw(r_padding, c_padding, "YOU RAN OUT OF ROCKETS :(");
 	}
 	
 	/* closing message */
-	mvprintw(r_padding +1, c_padding, "Escaped saucers: %d", escape_update);
-	mvprintw(r_padding +2, c_padding, "Rockets left: %d", shot_update);
-	mvprintw(r_padding +3, c_padding, "Final score: %d", score_update);
+	mvprintw(r_padding +1, c_padding, "Escaped saucers: %d", 
+	    game->escape_update);
+	mvprintw(r_padding +2, c_padding, "Rockets left: %d", 
+	    game->shot_update);
+	mvprintw(r_padding +3, c_padding, "Final score: %d", 
+	    game->score_update);
 	mvprintw(r_padding +4, c_padding, "Thanks for playing!");
 	mvprintw(r_padding +5, c_padding, "(Press 'Q' to exit)");
 	refresh();
 	
-	/* free allocated memory */
-	free(array[0]);
-	free(array);
-	
 	/* allow the user to exit the program */
 	while(1){
 		c = getch();
@@ -308,686 +1586,5399 @@ int main(int ac, char *av[]){
 	endwin();
 	return 0;
 }
+#endif
 
 
 /* 
- * lock_draw locks the draw mutex protecting a critical region that involves 
- * printing output and moves curser to corner of the screen
+ * lock_draw locks the draw lock exclusively, protecting a critical region 
+ * that involves the collision index, saucer and shot records, and queuing 
+ * their output
  */
 void lock_draw(){
-	pthread_mutex_lock(&draw);
-	move(LINES-1, COLS-1);
+	
+	long start = trace_now();
+	
+	lock_timed(&game->draw_timing);
+	trace_span("draw wait", start, -1);
 }
 
 
 /* 
- * unlock_draw moves cursor back and output changes on the screen
- * and unlocks draw mutex protecting critical region 
+ * unlock_draw unlocks draw mutex protecting critical region 
+ * render_loop outputs the queued changes once per frame
  */
 void unlock_draw(){
 	
-	move(LINES-1, COLS-1);
-	refresh();
-	pthread_mutex_unlock(&draw);
+	unlock_timed(&game->draw_timing);
 }
 
 
 /* 
- * setup_saucer populates one element (indexed at i) in saucerinfo
- * expects integer corresponding to the index, no return value
- */ 
-void setup_saucer(int i){
+ * lock_draw_shared locks the draw lock for a saucer or shot thread to move
+ * its own record. any number can hold it at once, so they must also hold 
+ * the stripe of each row whose intervals they use, see lock_row. pausing, 
+ * resizing and handing out slots hold it exclusively, which stops them all
+ * with -S shared holds are timed apart from exclusive ones. a thread holds
+ * it shared once at a time, as a waiting writer would block a second hold
+ */
+void lock_draw_shared(){
+	
+	long start;
+	
+	if(!timing){
+		pthread_rwlock_rdlock(&game->draw);
+		return;
+	}
+	start = now_ns();
+	pthread_rwlock_rdlock(&game->draw);
+	shared_acquired = now_ns();
+	hist_record(&game->draw_timing.shared_wait, shared_acquired - start);
+}
 
-	saucerinfo[i].row = (rand())%NUMROW;
-	saucerinfo[i].delay = 1+(rand()%15);
-	saucerinfo[i].index = i;
-	saucerinfo[i].colour = next_colour;
+void unlock_draw_shared(){
 	
-	/* loop colours */
-	if(next_colour == 6){
-		next_colour = 0;
+	if(timing){
+		hist_record(&game->draw_timing.shared_hold, 
+		    now_ns() - shared_acquired);
 	}
-	else{
-		next_colour ++;
-	}	
+	pthread_rwlock_unlock(&game->draw);
 }
 
 
 /* 
- * stats prints the # of rockets left and # of missed saucers on the screen
- * uses the draw mutex so draw must be unlocked before entering stats
- * score_mutex should be locked before entering
- * expects no args & no return values
+ * lock_row and unlock_row lock and unlock the stripe of the collision index
+ * for one row. a row's intervals can be used with its stripe held and draw 
+ * held shared, or with draw held exclusively. rows without saucers have 
+ * no stripe. a thread holds one stripe at a time, and may then lock 
+ * timer_mutex but nothing else
+ * expects the row, no return value
  */
-void stats(){
+void lock_row(int row){
+	
+	if(row >= 0 && row < saucer_rows){
+		lock_timed(&game->row_timing[row]);
+	}
+}
 
-	/* print message at bottom of the screen */
-	lock_draw();
-	mvprintw(LINES-1, 0, 
-	    " score: %d, rockets remaining: %d, escaped saucers: %d/%d        ", 
-	    score_update, shot_update, escape_update, MAXESCAPE);
+void unlock_row(int row){
+	
+	if(row >= 0 && row < saucer_rows){
+		unlock_timed(&game->row_timing[row]);
+	}
+}
 
-	unlock_draw();
+
+/* 
+ * now_ns reads the monotonic clock
+ * expects no args, returns the time in nanoseconds
+ */
+long now_ns(){
+	
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
 }
 
 
 /* 
- * launch_site responds to user input that moves the launch site
- * expects new direction and old position of the shot, returns the new position
+ * hist_record adds one time to a histogram. values below HISTSUB get a 
+ * bucket each, above that each power of 2 is split into HISTSUB buckets
+ * each count is added to on its own, relaxed, as nothing else is ordered 
+ * by them, so a histogram read while a time is being added can have it in
+ * some counts and not yet in others
+ * expects the histogram and time in nanoseconds, no return value
  */
-int launch_site(int direction, int position){
+void hist_record(struct histogram *h, long v){
 	
-	/* if we are within the range of the screen move to new position */
-	if(position+direction >= 0 && position+direction < COLS-3){
-		
-		/* new position */
-		position = direction + position;
-		
-		/* draw new position on screen */
-		lock_draw();
-		mvaddstr(LINES-2, position, " | ");
-		unlock_draw();
-	}
+	int msb, i;
+	long max;
 	
-	/* returns old pos if request was out of range, otherwise returns new */
-	return position;
+	if(v < 0){
+		v = 0;
+	}
+	if(v < HISTSUB){
+		i = v;
+	}
+	else{
+		msb = 63 - __builtin_clzl(v);
+		i = ((msb - HISTBITS + 1) << HISTBITS) + 
+		    ((v >> (msb - HISTBITS)) & (HISTSUB - 1));
+	}
+	atomic_fetch_add_explicit(&h->buckets[i], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->total, v, memory_order_relaxed);
+	max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	while(v > max && !atomic_compare_exchange_weak_explicit(&h->max, &max, 
+	    v, memory_order_relaxed, memory_order_relaxed)){
+	}
 }
 
 
-/*
- * saucer hit updates the collision array after a saucer has been hit
- * and replaces the saucer thread with a new one
- * expects the length to remove, column, saucerinfo, and a string to draw 
- * no return value
+/* 
+ * hist_value finds the time below which a fraction of a histogram's 
+ * values fall, to within the width of a bucket
+ * expects the histogram and fraction, returns the time in nanoseconds
  */
-void saucer_hit(int len, int col, struct saucerprop *info, char *shape){
+long hist_value(struct histogram *h, double fraction){
 	
 	int i;
-	int row = info->row;
-	int index = info->index;
-
-	lock_draw();
+	long seen = 0;
+	long top;
+	long count = atomic_load_explicit(&h->count, memory_order_relaxed);
+	long max = atomic_load_explicit(&h->max, memory_order_relaxed);
 	
-	/* draw over the saucer to remove it from the screen */
-	mvaddnstr(row, col, shape, len);
+	for(i = 0; i < HISTBUCKETS; i++){
+		seen += atomic_load_explicit(&h->buckets[i], 
+		    memory_order_relaxed);
+		if(seen > 0 && seen >= fraction * count){
+			break;
+		}
+	}
 	
-	/* remove saucer position from the collision array */
-	for(i = 0; i < len; i++){
-		collision_position[row][col+i].saucer --;
-		collision_position[row][col+i].here[index] = 0;
-		info->kill = 0;
+	/* the highest value that would land in bucket i */
+	if(i + 1 < HISTSUB){
+		top = i;
+	}
+	else{
+		top = ((long)(HISTSUB + ((i + 1) & (HISTSUB - 1))) << 
+		    (((i + 1) >> HISTBITS) - 1)) - 1;
 	}
+	return top < max ? top : max;
+}
+
+
+/* 
+ * lock_timed locks a mutex, and when timing records how long the caller 
+ * waited for it and notes when it was acquired
+ * expects the timed lock, no return value
+ */
+void lock_timed(struct timedlock *l){
 	
-	/* signal to replace the thread at that index */
-	pthread_mutex_lock(&replace_mutex);
+	long start;
 	
-	/* set global to index that can be replaced */
-	replace_index = index;
-	pthread_cond_signal(&replace_condition);
-	pthread_mutex_unlock(&replace_mutex);
+	if(!timing){
+		if(l->mutex){
+			pthread_mutex_lock(l->mutex);
+		}
+		else{
+			pthread_rwlock_wrlock(l->rwlock);
+		}
+		return;
+	}
+	start = now_ns();
+	if(l->mutex){
+		pthread_mutex_lock(l->mutex);
+	}
+	else{
+		pthread_rwlock_wrlock(l->rwlock);
+	}
 	
-	unlock_draw();
+	/* only the holder touches these, so the lock itself protects them */
+	l->acquired = now_ns();
+	hist_record(&l->wait, l->acquired - start);
 }
 
 
 /* 
- * new_saucer_position updates adds information in the collision array
- * draw mutex should be locked before entering this function
- * expects a row, column, and index. returns nothing 
+ * unlock_timed unlocks a mutex, and when timing records how long it was held
+ * expects the timed lock, no return value
  */
-void new_saucer_position(int row, int col, int index){
+void unlock_timed(struct timedlock *l){
 	
-	/* add new position position */
-	collision_position[row][col].saucer ++;
+	if(timing){
+		hist_record(&l->hold, now_ns() - l->acquired);
+	}
+	if(l->mutex){
+		pthread_mutex_unlock(l->mutex);
+	}
+	else{
+		pthread_rwlock_unlock(l->rwlock);
+	}
+}
+
+
+/* 
+ * mutex_cleanup unlocks the mutex of a thread cancelled in cond_wait
+ * expects the mutex, no return value
+ */
+void mutex_cleanup(void *mutex){
 	
-	/* provide a sign that this saucer is at that spot */
-	collision_position[row][col].here[index] = 1;
+	pthread_mutex_unlock(mutex);
 }
 
 
 /* 
- * saucers is the function used by all the saucer threads
- * is type void* and recieves argument void* b/c requirements of pthread_create
- * expects the start the address of the corresponding saucer properties
- * no return value
+ * cond_wait is pthread_cond_wait for a thread that can be cancelled: one 
+ * cancelled while waiting has the mutex back, and unlocks it before it 
+ * exits, so the threads main joins at the end never wait on it forever
+ * expects the condition variable and the mutex, locked, no return value
  */
-void *saucers(void *properties){	
+void cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex){
 	
-	int i;
-	void *retval;
-	char *shape = " <--->";
-	char *shape2= "      ";
-	char *shape3 = "<--->";
-	int len = strlen(shape);
-	int len2 = len;
-	int col = 0;
+	pthread_cleanup_push(mutex_cleanup, mutex);
+	pthread_cond_wait(cond, mutex);
+	pthread_cleanup_pop(0);
+}
+
+
+/* 
+ * wait_timed waits on a condition variable with a timed lock held. the 
+ * time spent waiting is not counted as holding the lock
+ * expects the condition variable and timed lock, no return value
+ */
+void wait_timed(pthread_cond_t *cond, struct timedlock *l){
 	
+	if(timing){
+		hist_record(&l->hold, now_ns() - l->acquired);
+	}
+	cond_wait(cond, l->mutex);
+	if(timing){
+		l->acquired = now_ns();
+	}
+}
+
+
+/* 
+ * trace_now reads the clock for the start of a trace span
+ * expects no args, returns the time in nanoseconds, or 0 when not tracing
+ */
+long trace_now(){
 	
-	/* points to properties info for a specific saucer */
-	struct saucerprop *info = properties;
+	return tracing ? now_ns() : 0;
+}
+
+
+/* 
+ * trace_add adds an event to the calling thread's trace, which it starts 
+ * the first time. nothing is locked: a thread only ever adds to its own 
+ * trace, and the list of traces and the total kept are atomic. once 
+ * TRACEMAX events are kept the rest are counted as dropped
+ * expects the name, the time it started and how long it took in 
+ * nanoseconds, or -1 for an instant, and the slot index or -1
+ * no return value
+ */
+void trace_add(const char *name, long ts, long dur, int arg){
 	
-	/* update the saucers */
-	while(1){
-		
-		/* remove the saucer if kill is set for that saucer */
-		if(info->kill == 1){
-		
-			/* remove saucer info */
-			saucer_hit(len2, col, info, shape2);
-		
-			/* finish with the thread */
-			pthread_exit(retval);
-		}
-		
-		/* thread sleeps for (its delay time * defined timeunits) */
-		usleep(info->delay*SAUCERSPEED);
-		
-		/* lock the draw mutex CRITICAL REGION BELOW */
-		lock_draw();
-		
-		/* set colour only if the global use_colour is set to 1 */
-		if(use_colour){
-			
-			/* change colour of terminal */
-			attron(COLOR_PAIR(info->colour));
+	struct trace *t = trace_own;
+	struct tracechunk *c;
+	struct traceevent *e;
+	int n;
+	
+	if(t == NULL){
+		t = calloc(1, sizeof(*t));
+		if(t == NULL){
+			fprintf(stderr, "calloc failed, maybe we ran out of "
+			    "memory\n");
+			exit(-1);
 		}
-		
-		/* if not overlapping */
-		if(collision_position[info->row][col].saucer <= 1){
-			
-			/* print the saucer on the screen at (row, col) */
-			mvaddnstr(info->row, col, shape, len2);
+		t->tid = atomic_fetch_add(&trace_threads, 1) + 1;
+		t->next = atomic_load(&traces);
+		while(!atomic_compare_exchange_weak(&traces, &t->next, t)){
 		}
-		
-		/* if overlapping with another saucer */
-		else{
-			/* print saucer without the padding at the end */
-			mvaddnstr(info->row, col+1, shape3, len2-1);
+		trace_own = t;
+	}
+	
+	/* a new chunk when the last one is full */
+	c = t->last;
+	if(c == NULL || atomic_load_explicit(&c->n, memory_order_relaxed) 
+	    == TRACECHUNK){
+		if(atomic_fetch_add(&trace_events, TRACECHUNK) >= TRACEMAX){
+			atomic_fetch_add(&trace_dropped, 1);
+			return;
 		}
-		
-		/* unset colour only if the global use_colour is set to 1 */
-		if(use_colour){
-			
-			/* change colour back to default */
-			attroff(COLOR_PAIR(info->colour));
+		c = calloc(1, sizeof(*c));
+		if(c == NULL){
+			fprintf(stderr, "calloc failed, maybe we ran out of "
+			    "memory\n");
+			exit(-1);
 		}
-		
-		/* update collision array. col+1 because of the extra space */
-		for(i=0; i<len2; i++){
-			
-			/* sets saucer and there[i] in collision array*/
-			new_saucer_position(info->row, col+1+i, info->index);
-			
-			/* remove old position if not first time through loop */
-			if(col>0){
-				collision_position[info->row][col+i].saucer --;
-			}
+		if(t->last == NULL){
+			atomic_store_explicit(&t->first, c, 
+			    memory_order_release);
 		}
-		
-		/* only remove the one column that changed in collision array */
-		collision_position[info->row][col].here[info->index]= 0;
-		
-		/* for testing only
-		for(i = 0; i < COLS-1; i++){
-			mvprintw(info->row+NUMROW, i, "%d", 
-		collision_position[info->row][i].saucer);
-			//mvprintw(info->row+2*NUMROW+1, i, "%d", 
-		//collision_position[info->row][i].here[info->index]);
+		else{
+			atomic_store_explicit(&t->last->next, c, 
+			    memory_order_release);
 		}
-		*/
-		
-		/* move cursor back and output changes on the screen */
-		unlock_draw();
+		t->last = c;
+	}
+	n = atomic_load_explicit(&c->n, memory_order_relaxed);
+	e = &c->events[n];
+	e->name = name;
+	e->ts = ts;
+	e->dur = dur;
+	e->arg = arg;
+	atomic_store_explicit(&c->n, n + 1, memory_order_release);
+}
 
-		/* move to next column */
-		col ++;
-		
-		/* when we reach the end of the screen start to stop writing */
-		if (col+len >= COLS){
-			
-			/* @ end - write progressively less of the string */
-			len2 --;
-			
-			/* now the string is off the page, exit the thread */
-			if(len2 == 0){
 
-				/* update the score now that a saucer escaped */
-				pthread_mutex_lock(&score_mutex);
-				escape_update ++;
-				stats();
-				
-				/* if we have reached the max escaped saucers */
-				if(escape_update == MAXESCAPE){
-					
-					/* send signal to the main function */
-					pthread_mutex_lock(&end_mutex);
-					pthread_cond_signal(&end_condition);
-					pthread_mutex_unlock(&end_mutex);
-					
-					/* we are done with the thread now */
-					pthread_exit(retval);
-				}
-				pthread_mutex_unlock(&score_mutex);
-				
-				/* signal that the thread can be replaced */
-				pthread_mutex_lock(&replace_mutex);
-				
-				/* set global to index that can be replaced */
-				replace_index = info->index;
-				pthread_cond_signal(&replace_condition);
-				pthread_mutex_unlock(&replace_mutex);
-				
-				/* now we are finished with the thread */
-				pthread_exit(retval);
-			}
-		}	
+/* 
+ * trace_event traces something that happened now, when tracing
+ * expects the name of the event and the slot index or -1, no return value
+ */
+void trace_event(const char *name, int arg){
+	
+	if(tracing){
+		trace_add(name, now_ns(), -1, arg);
 	}
 }
 
 
 /* 
- * rand_saucers adds a new saucer 
- * expects the current number of active saucers, returns the new number saucers
+ * trace_span traces something that took from a time until now, when tracing
+ * expects the name, the start from trace_now and the slot index or -1
+ * no return value
  */
-int rand_saucers(int n){
+void trace_span(const char *name, long start, int arg){
 	
-	/* populate saucerinfo */
-	setup_saucer(n);
-	
-	/* create a saucer thread */
-	if (pthread_create(&saucer_t[n], NULL, saucers, &saucerinfo[n])){
-		fprintf(stderr,"error creating saucer thread\n");
-		endwin();
-		exit(-1);
+	if(tracing){
+		trace_add(name, start, now_ns() - start, arg);
 	}
-		
-	/* new number of saucers */
-	n ++;
-	return n;
 }
 
 
-/*
- * replace_thread is run constantly by one thread
- * it replaces a saucer thread that has finished running with a new saucer 
- * allows many threads to be created but only a fixed number of active threads
- * and a set amount of threads to be stored in an array
+/* 
+ * trace_write writes every thread's trace to trace_path as Chrome trace 
+ * event JSON: complete events for spans and thread scoped instants, times
+ * in microseconds since tracing started. run at exit, when threads that
+ * were cancelled may have stopped part way through an event, which is 
+ * then left out
  * expects no args & no return values
  */
-void *replace_thread(){
+void trace_write(){
 	
-	void *retval;
-	int i;
+	int i, n;
+	char *sep = "\n";
+	FILE *f = fopen(trace_path, "w");
+	struct trace *t;
+	struct tracechunk *c;
+	struct traceevent *e;
 	
-	while(1){
+	if(f == NULL){
+		perror(trace_path);
+		return;
+	}
+	fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+	for(t = atomic_load(&traces); t != NULL; t = t->next){
+		c = atomic_load_explicit(&t->first, memory_order_acquire);
+		for(; c != NULL; c = atomic_load_explicit(&c->next, 
+		    memory_order_acquire)){
+			n = atomic_load_explicit(&c->n, memory_order_acquire);
+			for(i = 0; i < n; i++){
+				e = &c->events[i];
+				fprintf(f, "%s{\"name\": \"%s\", "
+				    "\"pid\": 1, \"tid\": %d, \"ts\": %.3f, ", 
+				    sep, e->name, t->tid, 
+				    (e->ts - trace_start) / 1e3);
+				if(e->dur < 0){
+					fprintf(f, "\"ph\": \"i\", "
+					    "\"s\": \"t\"");
+				}
+				else{
+					fprintf(f, "\"ph\": \"X\", "
+					    "\"dur\": %.3f", e->dur / 1e3);
+				}
+				if(e->arg >= 0){
+					fprintf(f, ", \"args\": "
+					    "{\"slot\": %d}", e->arg);
+				}
+				fprintf(f, "}");
+				sep = ",\n";
+			}
+		}
+	}
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	if(trace_dropped){
+		fprintf(stderr, "trace: %ld events dropped after the "
+		    "first %d\n", (long)trace_dropped, TRACEMAX);
+	}
+}
 
-		/* wait until given the signal to replace a thread */
-		pthread_mutex_lock(&replace_mutex);
-		pthread_cond_wait(&replace_condition, &replace_mutex);
 
-		/* wait until thread terminates for sure before replacing it */
-		pthread_join(saucer_t[replace_index], &retval);
-		
-		i = replace_index;
+/* 
+ * hist_print writes one line of a stats file for a histogram
+ * expects the file, the name of the line, the histogram and what to divide
+ * its values by, 1000 for times in microseconds, no return value
+ */
+void hist_print(FILE *f, char *name, char *kind, struct histogram *h, 
+    double unit){
 	
-		/* optional delay */
-	 	/* sleep(2); */
+	long count = atomic_load_explicit(&h->count, memory_order_relaxed);
+	long total = atomic_load_explicit(&h->total, memory_order_relaxed);
+	long max = atomic_load_explicit(&h->max, memory_order_relaxed);
 	
-		/* populate new saucer + create new thread reusing old index */
-		setup_saucer(replace_index);
-		if(pthread_create(&saucer_t[i], NULL, saucers, &saucerinfo[i])){
-			fprintf(stderr,"error replacing saucer thread\n");
-			endwin();
-			exit(-1);
-		}
-		pthread_mutex_unlock(&replace_mutex);
-	}
+	fprintf(f, "%-8s %-5s %10ld %10.2f %10.2f %10.2f %10.2f %10.2f "
+	    "%10.2f\n", name, kind, count, count ? total / unit / count : 0.0,
+	    hist_value(h, 0.5) / unit, hist_value(h, 0.9) / unit,
+	    hist_value(h, 0.99) / unit, hist_value(h, 0.999) / unit,
+	    max / unit);
 }
 
 
-/*
- * find hit locates hit saucers, draws over a shot at a given position,
- * and adds 1 point to the score+shots
- * NOTE: must have draw mutex locked before entering function 
- * expects row and col as args, returns nothing
+/* 
+ * stats_write writes the lock, frame and tick histograms to the stats file
+ * on SIGUSR1 the other threads are still recording, see hist_record, at 
+ * the end of a game main has joined them first
+ * expects no args & no return values
  */
-void find_hit(int row, int col){
-	int i; 
-	int hits = 0;
+void stats_write(){
 	
-	for(i = 0; i<MAXSAUCERS; i++){
+	int i;
+	FILE *f = fopen(stats_path, "w");
 	
-		/* check if any saucer thread is a hit */
-		if(collision_position[row][col].here[i] != 0){
-	
-			/* set kill for hit saucers */
-			saucerinfo[i].kill = 1;
-			
-			/* keep track of how many saucers were hit */
-			hits++;	
+	if(f == NULL){
+		return;
+	}
+	fprintf(f, "%-14s %10s %10s %10s %10s %10s %10s %10s\n", 
+	    "times in us", "count", "mean", "p50", "p90", "p99", "p99.9", 
+	    "max");
+	for(i = 0; timed_locks[i] != NULL; i++){
+		hist_print(f, timed_locks[i]->name, "wait", 
+		    &timed_locks[i]->wait, 1000.0);
+		hist_print(f, timed_locks[i]->name, "hold", 
+		    &timed_locks[i]->hold, 1000.0);
+		if(timed_locks[i]->rwlock){
+			hist_print(f, timed_locks[i]->name, "swait", 
+			    &timed_locks[i]->shared_wait, 1000.0);
+			hist_print(f, timed_locks[i]->name, "shold", 
+			    &timed_locks[i]->shared_hold, 1000.0);
 		}
 	}
-	unlock_draw();
+	for(i = 0; i < saucer_rows; i++){
+		hist_print(f, game->row_timing[i].name, "wait", 
+		    &game->row_timing[i].wait, 1000.0);
+		hist_print(f, game->row_timing[i].name, "hold", 
+		    &game->row_timing[i].hold, 1000.0);
+	}
+	hist_print(f, "frame", "", &frame_hist, 1000.0);
+	hist_print(f, "tick", "", &game->tick_hist, 1000.0);
 	
-	/* update the score */
-	pthread_mutex_lock(&score_mutex);
+	/* bytes output by each frame that changed the screen */
+	fprintf(f, "%-14s\n", "sizes in bytes");
+	hist_print(f, "frame", ansi ? "ansi" : "curs", &bytes_hist, 1.0);
+	fclose(f);
+}
 
-	/* add one point to the score */
-	score_update = score_update + hits; 
-	pthread_mutex_lock(&shot_mutex);
-	/* reward a hit with more shots */
-	shot_update = shot_update + hits; 
-	stats();
-	pthread_mutex_unlock(&shot_mutex);
-	pthread_mutex_unlock(&score_mutex);
+
+/* 
+ * stats_signal asks for the stats file to be written, from SIGUSR1. it is 
+ * written by the render thread, or the headless loop, at its next chance
+ * expects the signal number, no return value
+ */
+void stats_signal(int sig){
+	
+	(void)sig;
+	atomic_store(&stats_requested, 1);
 }
 
 
 /* 
- * shots is the function used by all the shot threads
- * prints shots on the screen
- * in this program, recieves the address of the corresponding shot properties
- * in this program, returns nothing
+ * stats_poll writes the stats file if SIGUSR1 has asked for it
+ * expects no args & no return values
  */
-void *shots(void *properties){
+void stats_poll(){
+	
+	if(atomic_load(&stats_requested) && 
+	    atomic_exchange(&stats_requested, 0)){
+		stats_write();
+	}
+}
+
+
+/* 
+ * sleep_until moves an absolute deadline on by a number of microseconds 
+ * and sleeps until it, so a loop using it keeps its pace without drifting
+ * expects the deadline and period, no return value
+ */
+void sleep_until(struct timespec *next, long period){
+	
+	next->tv_nsec += period * 1000L;
+	while(next->tv_nsec >= 1000000000L){
+		next->tv_nsec -= 1000000000L;
+		next->tv_sec ++;
+	}
+	
+	/* carry on sleeping if a signal interrupts */
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next, NULL)){
+	}
+}
 
-	int hit = 0;
+
+/* 
+ * draw_start allocates the draw command ring, each slot starting with a 
+ * sequence number equal to its index so it reads as free
+ * expects no args & no return values
+ */
+void draw_start(){
+	
 	int i;
-	struct shotprop *info = properties;
-	void *retval;
 	
-	/* initial row at bottom of screen */
-	info->row = LINES - 3;
+	draws.slots = calloc(DRAWQUEUE, sizeof(*draws.slots));
+	if(draws.slots == NULL){
+		fprintf(stderr, "calloc failed creating the draw queue\n");
+		endwin();
+		exit(-1);
+	}
+	for(i = 0; i < DRAWQUEUE; i++){
+		atomic_init(&draws.slots[i].seq, i);
+	}
+}
+
+
+/* 
+ * draw_push adds a command to the draw queue without locking. producers 
+ * claim a position by advancing head, a slot is free when its sequence 
+ * number equals that position and is published by setting it one past
+ * if the queue is full the producer yields until the render thread drains
+ * expects the command, no return value
+ */
+void draw_push(struct drawcmd *cmd){
 	
+	struct drawslot *slot;
+	size_t pos = atomic_load_explicit(&draws.head, memory_order_relaxed);
+	long diff;
 	
 	while(1){
+		slot = &draws.slots[pos & (DRAWQUEUE - 1)];
+		diff = (long)atomic_load_explicit(&slot->seq, 
+		    memory_order_acquire) - (long)pos;
 		
-		/* specify the delay in SHOTSPEED */
-		usleep(SHOTSPEED);
-		
-		lock_draw();
-		
-		/* cover the old shot if no saucer has moved there */
-		if(collision_position[info->row][info->col].saucer == 0){
-			mvaddch(info->row, info->col, ' ');
+		/* free: try to claim it, on failure pos holds the new head */
+		if(diff == 0){
+			if(atomic_compare_exchange_weak_explicit(&draws.head, 
+			    &pos, pos + 1, memory_order_relaxed, 
+			    memory_order_relaxed)){
+				break;
+			}
 		}
 		
-		/* remove the old position from the collision array */
-		if( info->row >= 0 && info->row < LINES-1){
-			collision_position[info->row][info->col].shot --;	
+		/* full: the render thread has not drained this slot yet */
+		else if(diff < 0){
+			sched_yield();
+			pos = atomic_load_explicit(&draws.head, 
+			    memory_order_relaxed);
 		}
 		
-		/* the new position one row up */
-		info->row --;
-		
-		/* update the new position in the collision array */
-		if( info->row >= 0 && info->row < LINES-1){
-			collision_position[info->row][info->col].shot ++;
-			
-			/* hit = # of saucers at that position */
-			hit = collision_position[info->row][info->col].saucer;
-			if(hit > 0){
-				
-				/* find hits and update score, release draw */
-				find_hit(info->row, info->col);
-				
-				/* now we are done with this shot */
-				pthread_exit(retval);
-			}
+		/* another producer claimed it first */
+		else{
+			pos = atomic_load_explicit(&draws.head, 
+			    memory_order_relaxed);
 		}
-		
-		/* if no hit draw the new shot at the new position one row up */
-		mvaddch(info->row, info->col, '^');
-		
-		/* move cursor back and output changes on the screen */
-		unlock_draw();
-		
-		/* if reach the top of the screen without hitting anything */
-		if(info->row < 0){
-			
-			/* now we are finished with the thread */
-			pthread_exit(retval);
+	}
+	slot->cmd = *cmd;
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+
+/* 
+ * draw_pop takes the oldest published command off the draw queue
+ * only the render thread calls draw_pop
+ * expects where to store the command, returns 1 if there was one, else 0
+ */
+int draw_pop(struct drawcmd *cmd){
+	
+	struct drawslot *slot = &draws.slots[draws.tail & (DRAWQUEUE - 1)];
+	
+	if(atomic_load_explicit(&slot->seq, memory_order_acquire) != 
+	    draws.tail + 1){
+		return 0;
+	}
+	*cmd = slot->cmd;
+	
+	/* free the slot for the producer that wraps round to it */
+	atomic_store_explicit(&slot->seq, draws.tail + DRAWQUEUE, 
+	    memory_order_release);
+	draws.tail ++;
+	return 1;
+}
+
+
+/* 
+ * draw_apply makes the curses calls for one draw command
+ * only the render thread calls draw_apply
+ * expects the command, no return value
+ */
+void draw_apply(struct drawcmd *cmd){
+	
+	if(ansi){
+		ansi_apply(cmd);
+		return;
+	}
+	if(cmd->op == DRAW_STATUS){
+		mvprintw(LINES-1, 0, STATUS, cmd->score, cmd->rockets, 
+		    cmd->escaped, MAXESCAPE);
+		return;
+	}
+	if(cmd->colour){
+		attron(COLOR_PAIR(cmd->colour));
+	}
+	mvaddnstr(cmd->row, cmd->col, cmd->text, cmd->len);
+	if(cmd->colour){
+		attroff(COLOR_PAIR(cmd->colour));
+	}
+}
+
+
+/* 
+ * key_push queues a key read by the render thread for read_key, dropping 
+ * it if the player is far ahead of the game. the autopilot's keys are 
+ * dropped sooner, so they never take the room the player's need
+ * expects the key and the most keys it may be queued behind, KEYQUEUE for
+ * the player's and AUTOKEYS for the autopilot's, no return value
+ */
+void key_push(int c, int room){
+	
+	pthread_mutex_lock(&keys.lock);
+	if(keys.tail - keys.head < room){
+		keys.keys[keys.tail % KEYQUEUE] = c;
+		keys.tail ++;
+		pthread_cond_signal(&keys.ready);
+	}
+	pthread_mutex_unlock(&keys.lock);
+}
+
+
+/* 
+ * put_varint writes an unsigned number 7 bits at a time, low bits first, 
+ * with the top bit of each byte set if more bytes follow
+ * expects the file and number, no return value
+ */
+void put_varint(FILE *file, unsigned long n){
+	
+	while(n >= 0x80){
+		fputc((n & 0x7f) | 0x80, file);
+		n >>= 7;
+	}
+	fputc(n, file);
+}
+
+
+/* 
+ * get_varint reads a number written by put_varint
+ * expects the file and where to store the number, returns 0 at end of file
+ */
+int get_varint(FILE *file, unsigned long *n){
+	
+	int c;
+	int shift = 0;
+	
+	*n = 0;
+	while((c = fgetc(file)) != EOF){
+		*n |= (unsigned long)(c & 0x7f) << shift;
+		if(!(c & 0x80)){
+			return 1;
 		}
+		shift += 7;
 	}
+	return 0;
 }
 
 
-/*
- * find_end waits for a shot thread to end and checks if the program can exit
- * if the shot finishes without hitting anything the program can exit
- * otherwise more shots are available and the game can continue
- * expects the address of the shot of interest thread id, no return values
+/* 
+ * rec_open opens a recording to write or to replay. a replay reads the 
+ * header, which decides the engine, screen size and seed of the game
+ * expects the path and REC_WRITE or REC_REPLAY, returns 0 or -1 on error
  */
-void *find_end(){//void *index){
+int rec_open(char *path, int mode){
 	
-	void *retval;
-	int track;
+	unsigned char header[RECHEADER];
+	
+	rec.file = fopen(path, mode == REC_WRITE ? "wb" : "rb");
+	if(rec.file == NULL){
+		return -1;
+	}
+	rec.mode = mode;
+	if(mode == REC_WRITE){
+		return 0;
+	}
 	
-	/* keep track of the index we are currently looking at */
-	track = save;
+	if(fread(header, 1, RECHEADER, rec.file) != RECHEADER || 
+	    memcmp(header, "SAUC", 4) != 0 || header[4] != 3){
+		fclose(rec.file);
+		return -1;
+	}
+	rec.ticks = header[5];
+	rec.rows = header[6] | header[7] << 8;
+	rec.cols = header[8] | header[9] << 8;
+	rec.seed = header[10] | header[11] << 8 | header[12] << 16 | 
+	    (unsigned)header[13] << 24;
+	rec.scale = header[14] | header[15] << 8;
+	if(rec.scale < 1){
+		fclose(rec.file);
+		return -1;
+	}
+	return 0;
+}
+
+
+/* 
+ * seed_game seeds the main game, with the seed from the recording 
+ * when replaying, and writes the recording header when recording
+ * also starts the clock that event times are measured from
+ * expects the seed to use when not replaying, no return value
+ */
+void seed_game(unsigned seed){
 	
-	/* when there is no chance of hitting any other saucers */
-	pthread_join(shot_t[track], &retval);
+	unsigned char header[RECHEADER] = {'S', 'A', 'U', 'C', 3};
 	
-	/* must have 0 shots left and must be last shot ever (no updates!) */
-	pthread_mutex_lock(&shot_mutex);
-	if(shot_update == 0 && track == save){
-		
-		/* if the last shot fired and misses: signal to exit game */
-		pthread_mutex_lock(&end_mutex);
-		pthread_cond_signal(&end_condition); 
-		pthread_mutex_unlock(&end_mutex);
-		pthread_exit(&retval);
+	if(rec.mode == REC_REPLAY){
+		seed = rec.seed;
 	}
+	game_seed(seed, 0);
+	clock_gettime(CLOCK_MONOTONIC, &rec.start);
+	rec.last = 0;
 	
-	/* if the last shot does hit something go back to allowing new shots */
-	pthread_mutex_unlock(&shot_mutex);
-	pthread_exit(&retval);
+	if(rec.mode == REC_WRITE){
+		rec.ticks = game->tick_engine;
+		header[5] = rec.ticks;
+		header[6] = game->screen_rows & 0xff;
+		header[7] = game->screen_rows >> 8;
+		header[8] = game->screen_cols & 0xff;
+		header[9] = game->screen_cols >> 8;
+		header[10] = seed & 0xff;
+		header[11] = seed >> 8;
+		header[12] = seed >> 16;
+		header[13] = seed >> 24;
+		header[14] = tick_scale & 0xff;
+		header[15] = tick_scale >> 8;
+		fwrite(header, 1, RECHEADER, rec.file);
+	}
 }
 
 
 /* 
- * fire shot creates a new shot
- * expects the current index of the shot_t array and the current launch position
- * if there are no shots left, returns -1, otherwise returns the new index
+ * rec_time is when an event happens: the tick number in the tick engine 
+ * or microseconds since the game started otherwise
+ * expects no args, returns the time
  */
-int fire_shot(int i, int launch_position){
+long rec_time(){
 	
-	void *retval;
-	int end_i;
+	struct timespec now;
 	
-	/* store index of the current last shot fired in end_i */
-	if(i != 0){
-		end_i = i - 1;
+	if(game->tick_engine){
+		return game->tick_count;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - rec.start.tv_sec) * 1000000L + 
+	    (now.tv_nsec - rec.start.tv_nsec) / 1000;
+}
+
+
+/* 
+ * rec_key adds a key the player pressed to the recording
+ * expects the key, no return value
+ */
+void rec_key(int c){
+	
+	long t = rec_time();
+	
+	/* times only go forward, so store the gap since the last event */
+	put_varint(rec.file, t - rec.last);
+	put_varint(rec.file, c);
+	rec.last = t;
+}
+
+
+/* 
+ * rec_peek reads the next replayed event, if it has not been read already
+ * a finished recording replays as 'Q' so the game ends with it
+ * expects no args & no return values
+ */
+void rec_peek(){
+	
+	unsigned long gap, c;
 	
-	/* if the current index is zero that means the last index looped */
+	if(rec.ready){
+		return;
+	}
+	if(get_varint(rec.file, &gap) && get_varint(rec.file, &c)){
+		rec.next = rec.last + gap;
+		rec.key = c;
+	}
 	else{
-		end_i = MAXSHOTS - 1;
+		rec.next = rec.last;
+		rec.key = 'Q';
 	}
+	rec.last = rec.next;
+	rec.ready = 1;
+}
+
+
+/* 
+ * key_pop takes the next key pressed by the player off the key queue and 
+ * records it
+ * expects 1 to wait for a key or 0 not to, returns the key or ERR if none
+ */
+int key_pop(int wait){
 	
-	/* if we still have shots left create fire a new shot */
-	pthread_mutex_lock(&shot_mutex);
-	if(shot_update > 0){
-		pthread_mutex_unlock(&shot_mutex);
+	int c = ERR;
 	
-		/* loop to begining of the array to reuse indices */
-		if(i == MAXSHOTS){
-			i = 0;
-		}
+	pthread_mutex_lock(&keys.lock);
+	while(wait && keys.head == keys.tail){
+		cond_wait(&keys.ready, &keys.lock);
+	}
+	if(keys.head != keys.tail){
+		c = keys.keys[keys.head % KEYQUEUE];
+		keys.head ++;
+	}
+	pthread_mutex_unlock(&keys.lock);
 	
-		/* set row & col for the shot (pos+1 b/c of the space before|)*/
-		shotinfo[i].col = launch_position + 1;
+	if(c != ERR && rec.mode == REC_WRITE){
+		rec_key(c);
+	}
+	return c;
+}
+
+
+/* 
+ * replay_quit drops the keys the player presses while a recording is 
+ * replayed, as the recording has its own, except 'Q', which stops it
+ * expects no args, returns 1 if 'Q' was pressed and 0 otherwise
+ */
+int replay_quit(){
 	
-		/* create a thread for the shot */
-		if(pthread_create(&shot_t[i], NULL, shots, &shotinfo[i])){
-			fprintf(stderr,"error creating shot thread\n");
-			endwin();
-			exit(-1);
+	int c;
+	
+	while((c = key_pop(0)) != ERR){
+		if(c == 'Q'){
+			return 1;
 		}
-		
-		/* update and print the score now that a shot has been used */
-		pthread_mutex_lock(&score_mutex);
-		pthread_mutex_lock(&shot_mutex);
-		shot_update --;
-		stats();
-		pthread_mutex_unlock(&shot_mutex);
-		pthread_mutex_unlock(&score_mutex);
-		
-		/* update the current next shot now that there is a new shot */
-		end_i = i;
 	}
+	return 0;
+}
+
+
+/* 
+ * read_key waits for the next key pressed by the player, or for the next 
+ * replayed key and the time it was pressed at. keys read are recorded
+ * expects no args, returns the key
+ */
+int read_key(){
 	
-	/* update save with the current index */
-	save = end_i;
-	pthread_mutex_unlock(&shot_mutex);
+	long wait;
 	
-	/* if the shot thread is at zero, see if it remains at zero */
-	pthread_mutex_lock(&shot_mutex);
-	if(shot_update == 0){
-		pthread_mutex_unlock(&shot_mutex);
+	if(rec.mode == REC_REPLAY){
+		rec_peek();
 		
-		/* create a thread to wait for the last shot to finish */
-		if(pthread_create(&end_t, NULL, find_end, NULL)){
-			fprintf(stderr,"error creating shot thread\n");
-			endwin();
-			exit(-1);
+		/* the threaded engine replays in real time, waiting at most */
+		/* a frame at a time so the player can stop it with 'Q'	     */
+		while(!game->tick_engine && (wait = rec.next - rec_time()) > 0){
+			if(replay_quit()){
+				return 'Q';
+			}
+			usleep(wait < 1000000 / frame_rate ? 
+			    wait : 1000000 / frame_rate);
 		}
+		if(replay_quit()){
+			return 'Q';
+		}
+		rec.ready = 0;
+		return rec.key;
 	}
-	pthread_mutex_unlock(&shot_mutex);
+	
+	return key_pop(1);
+}
+
 
-	/* move to next shot for next call */
-	end_i ++;
+/* 
+ * poll_key is read_key for the tick engine, which handles keys between 
+ * ticks: it returns a key only if one is due, and never waits
+ * expects no args, returns the key or ERR if there is none this tick
+ */
+int poll_key(){
 	
-	/* return the next available index for the next shot */
-	return end_i;
+	if(rec.mode == REC_REPLAY){
+		rec_peek();
+		if(rec.next > game->tick_count){
+			return replay_quit() ? 'Q' : ERR;
+		}
+		return read_key();
+	}
+	return key_pop(0);
 }
 
 
-/*
- * process_input deals with the user input from the terminal
- * in this program process_input is run as a single thread
- * expects no arguments, no return value
+/* 
+ * thread_written reads how many bytes the calling thread has written, to 
+ * count what a refresh outputs as curses does not say
+ * expects no args, returns the number of bytes or 0 if it can't be read
  */
-void *process_input(){
+long thread_written(){
 	
-	int i, c;
-	int launch_position = (COLS-1)/2;
-	int nsaucers = NUMSAUCERS;
-	int shot_i = 0;
-	void *retval;
+	long n = 0;
+	char line[64];
+	FILE *f = fopen("/proc/thread-self/io", "r");
 	
-	/* print message with info about the game @ the bottom of the page */
-	stats();
+	if(f == NULL){
+		return 0;
+	}
+	while(fgets(line, sizeof(line), f) != NULL){
+		if(sscanf(line, "wchar: %ld", &n) == 1){
+			break;
+		}
+	}
+	fclose(f);
+	return n;
+}
+
+
+/* 
+ * ansi_resize sizes the ANSI renderer's buffers for the terminal. every 
+ * cell of the front buffer is set to a character never drawn, so the next
+ * frame writes the whole screen. only the render thread calls ansi_resize
+ * expects the number of rows and cols, no return value
+ */
+void ansi_resize(int rows, int cols){
 	
-	/* draw original launch site in the middle of the screen */
-	launch_site(0, launch_position);
+	int n = rows * cols;
 	
-	/* set a seed so rand() results will be different each game */
-	srand(getpid());
+	term.rows = rows;
+	term.cols = cols;
+	term.front = realloc(term.front, n);
+	term.back = realloc(term.back, n);
+	term.front_colour = realloc(term.front_colour, n);
+	term.back_colour = realloc(term.back_colour, n);
+	term.iov = realloc(term.iov, (rows + 1) * sizeof(*term.iov));
+	if(term.front == NULL || term.back == NULL || term.front_colour == NULL
+	    || term.back_colour == NULL || term.iov == NULL){
+		endwin();
+		fprintf(stderr, "out of memory for the screen buffers\n");
+		exit(-1);
+	}
+	memset(term.front, 0, n);
+	memset(term.back, ' ', n);
+	memset(term.front_colour, 0, n);
+	memset(term.back_colour, 0, n);
+}
+
+
+/* 
+ * ansi_put adds bytes to the frame being built, growing it when needed
+ * expects the bytes and how many, no return value
+ */
+void ansi_put(const char *bytes, size_t n){
 	
-	/* create a thread for each initial saucer */
-	for(i=0; i<NUMSAUCERS; i++){
-		
-		/* populate saucerinfo for the initial saucers */
-		setup_saucer(i);
-		
-		/* each thread is created - runs/exits in saucers function */
-		if(pthread_create(&saucer_t[i], NULL, saucers, &saucerinfo[i])){
-			fprintf(stderr,"error creating saucer thread\n");
+	if(term.len + n > term.cap){
+		term.cap = 2 * (term.len + n);
+		term.out = realloc(term.out, term.cap);
+		if(term.out == NULL){
 			endwin();
+			fprintf(stderr, "out of memory for the frame output\n");
 			exit(-1);
 		}
 	}
+	memcpy(term.out + term.len, bytes, n);
+	term.len += n;
+}
+
+
+/* 
+ * ansi_apply makes the change of one draw command to the back buffer
+ * only the render thread calls ansi_apply
+ * expects the command, no return value
+ */
+void ansi_apply(struct drawcmd *cmd){
 	
-	/* process user input */
-	while(1){
-		
-		/* Add more saucers at random */
-		/* The more shots taken, the more saucers added */
-		if(rand()%RANDSAUCERS == 0 && nsaucers < MAXSAUCERS){
-			nsaucers = rand_saucers(nsaucers);
+	int i, n, cell;
+	int colour = cmd->colour;
+	char line[256];
+	char *text = cmd->text;
+	
+	n = cmd->len;
+	if(cmd->op == DRAW_STATUS){
+		n = snprintf(line, sizeof(line), STATUS, cmd->score, 
+		    cmd->rockets, cmd->escaped, MAXESCAPE);
+		text = line;
+		colour = 0;
+		cmd->row = term.rows - 1;
+		cmd->col = 0;
+	}
+	
+	/* like curses, anything off the screen is not drawn */
+	if(cmd->row < 0 || cmd->row >= term.rows){
+		return;
+	}
+	for(i = 0; i < n && text[i] != '\0'; i++){
+		if(cmd->col + i < 0 || cmd->col + i >= term.cols){
+			continue;
 		}
-		
-		/* read character from input and store in variable c */
-		c = getch();
+		cell = cmd->row * term.cols + cmd->col + i;
+		term.back[cell] = text[i];
+		term.back_colour[cell] = colour;
+	}
+}
 
-		/* quit program */
-		if(c == 'Q'){
-			
-			/* exit thread and return to main function */
-			pthread_mutex_lock(&end_mutex);
-			pthread_cond_signal(&end_condition);
-			pthread_mutex_unlock(&end_mutex);
-			break;
-		}
+
+/* 
+ * ansi_frame outputs the cells that differ between the back and front 
+ * buffers. on each row the cursor is moved to the first change, then past 
+ * each run of unchanged cells, unless writing them again is shorter. SGR 
+ * codes are only sent when the colour changes. the rows are written with 
+ * one writev, and the front buffer then matches the back
+ * only the render thread calls ansi_frame
+ * expects no args, returns the number of bytes output
+ */
+long ansi_frame(){
+	
+	int r, c, i, cell;
+	int pos, gap, colour = 0;
+	int rows = 0;
+	int same;
+	char move[32];
+	size_t start;
+	ssize_t n;
+	long left;
+	struct iovec *iov = term.iov;
+	
+	term.len = 0;
+	for(r = 0; r < term.rows; r++){
+		start = term.len;
 		
-		/* pausing the game: an intentional use of deadlock!! */
-		else if(c == 'p'){
-			
-			/* stop anything from being drawn on the screen */
-			lock_draw();
+		/* where the cursor is on this row, -1 until moved there */
+		pos = -1;
+		for(c = 0; c < term.cols; c++){
+			cell = r * term.cols + c;
 			
-			/* print message letting user know game is paused */
-			mvprintw(10, 10, "PAUSED");
-			mvprintw(11, 10, "(press 'p' to resume)");
-			refresh();
+			/* the bottom right cell is never written, so */
+			/* that the terminal does not scroll	      */
+			if((term.front[cell] == term.back[cell] && 
+			    term.front_colour[cell] == 
+			    term.back_colour[cell]) ||
+			    (r == term.rows-1 && c == term.cols-1)){
+				continue;
+			}
 			
-			/* wait for user to press 'p' to resume game */
-			while(1){
-				c = getch();
-				if (c == 'p'){
-					
-					/* cover pause message and return */
-					mvprintw(10,10,"      ");
-					mvprintw(11,10,"                     ");
-					refresh();
-					break;
-				}
+			/* cells skipped since the last change can be */
+			/* written again if they are few and the colour */
+			/* is set for them				*/
+			gap = c - pos;
+			same = pos >= 0 && gap < 4;
+			for(i = pos; same && i < c; i++){
+				same = term.back_colour[r * term.cols + i] 
+				    == colour;
 			}
-			
-			/* stop deadlock */
-			unlock_draw();
-		}
-		/* toggle turning colour on or off */
-		else if(c == 'c'){
-			
-			/* set use_colour to the opposite of what it is now */
-			lock_draw();
-			if (use_colour){
-				use_colour = 0;
+			if(same){
+				ansi_put(term.back + r * term.cols + pos, gap);
+			}
+			else if(pos >= 0){
+				ansi_put(move, snprintf(move, sizeof(move), 
+				    "\033[%dC", gap));
 			}
 			else{
-				use_colour = 1;
+				ansi_put(move, snprintf(move, sizeof(move), 
+				    "\033[%d;%dH", r + 1, c + 1));
 			}
-			unlock_draw();
+			if(term.back_colour[cell] != colour){
+				colour = term.back_colour[cell];
+				ansi_put(sgr_codes[colour], 
+				    strlen(sgr_codes[colour]));
+			}
+			ansi_put(term.back + cell, 1);
+			term.front[cell] = term.back[cell];
+			term.front_colour[cell] = term.back_colour[cell];
+			pos = c + 1;
 		}
 		
-		/* move launch site to the left */
-		else if(c == ','){
-			launch_position = launch_site(-1, launch_position);
+		/* the buffer may move as it grows, so keep offsets for now */
+		if(term.len > start){
+			iov[rows].iov_base = (void *)start;
+			iov[rows].iov_len = term.len - start;
+			rows ++;
+		}
+	}
+	if(rows == 0){
+		return 0;
+	}
+	
+	/* put the colour back and the cursor where curses leaves it */
+	start = term.len;
+	if(colour){
+		ansi_put(sgr_codes[0], strlen(sgr_codes[0]));
+	}
+	ansi_put(move, snprintf(move, sizeof(move), "\033[%d;%dH", 
+	    term.rows, term.cols));
+	iov[rows].iov_base = (void *)start;
+	iov[rows].iov_len = term.len - start;
+	rows ++;
+	for(i = 0; i < rows; i++){
+		iov[i].iov_base = term.out + (size_t)iov[i].iov_base;
+	}
+	
+	/* a write can be cut short, so carry on from where it stopped */
+	left = term.len;
+	while(left > 0 && rows > 0){
+		n = writev(STDOUT_FILENO, iov, rows < IOV_MAX ? rows : IOV_MAX);
+		if(n < 0 && errno == EINTR){
+			continue;
+		}
+		if(n < 0){
+			break;
+		}
+		left -= n;
+		while(rows > 0 && (size_t)n >= iov->iov_len){
+			n -= iov->iov_len;
+			iov ++;
+			rows --;
+		}
+		if(rows > 0){
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return term.len;
+}
+
+
+/* 
+ * render_frame applies every queued draw command, outputs them with one 
+ * refresh or ansi_frame, then passes on any keys pressed since the last 
+ * frame. when timing, the bytes output are recorded
+ * only the render thread calls render_frame
+ * expects no args & no return values
+ */
+void render_frame(){
+	
+	int c;
+	int changed = 0;
+	long bytes = 0;
+	long start = trace_now();
+	struct drawcmd cmd;
+	
+	while(draw_pop(&cmd)){
+		draw_apply(&cmd);
+		changed = 1;
+	}
+	if(changed && ansi){
+		bytes = ansi_frame();
+		trace_span("refresh", start, -1);
+	}
+	else if(changed){
+		if(timing){
+			bytes = thread_written();
 		}
 		
-		/* move launch site to the right */
-		else if(c == '.'){
-			launch_position = launch_site(1, launch_position);
+		/* move cursor back and output changes on the screen */
+		move(LINES-1, COLS-1);
+		refresh();
+		trace_span("refresh", start, -1);
+		if(timing){
+			bytes = thread_written() - bytes;
+		}
+	}
+	if(changed && timing){
+		hist_record(&bytes_hist, bytes);
+	}
+	
+	/* getch does not wait, see main. after a SIGWINCH curses has */
+	/* resized itself, and the game is told the new size in order */
+	/* with the keys, so a recording replays it at the same point */
+	while((c = getch()) != ERR){
+		if(c == KEY_RESIZE){
+			c = SIZE_KEY(LINES, COLS);
+			if(ansi){
+				ansi_resize(LINES, COLS);
+			}
+		}
+		key_push(c, KEYQUEUE);
+	}
+}
+
+
+/* 
+ * render_loop is run by a single thread that owns curses: every other 
+ * thread queues draw commands and reads keys through read_key. everything 
+ * drawn during a frame is output with one refresh, so the number of 
+ * terminal writes depends on the frame rate and not on the number of 
+ * saucers and shots. stops once main sets render_stop
+ * expects no args & no return values
+ */
+void *render_loop(){
+	
+	struct timespec next;
+	
+	long start;
+	
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while(!render_stop){
+		sleep_until(&next, 1000000L / frame_rate);
+		if(timing){
+			start = now_ns();
+			render_frame();
+			hist_record(&frame_hist, now_ns() - start);
+			stats_poll();
+		}
+		else{
+			render_frame();
 		}
+	}
+	
+	/* output anything still queued */
+	render_frame();
+	return NULL;
+}
+
+
+/* 
+ * scr_addnstr draws at most n characters of a string at (row, col), by 
+ * queuing draw commands for the render thread, or into the in-memory screen
+ * when headless. uses the colour last set by this thread with scr_colour
+ * expects the position, string and length, no return value
+ */
+void scr_addnstr(int row, int col, const char *str, int n){
+	
+	int i, j;
+	struct drawcmd cmd;
+	
+	if(!game->headless){
 		
-		/* fire one shot */
-		else if(c == ' '){
-			
-			/* if we are not out of shots yet fire the next one */
-			pthread_mutex_lock(&shot_mutex);
-			if(shot_update > 0){
-				pthread_mutex_unlock(&shot_mutex);
-				
-				/* fire_shot returns next shot index */
-				shot_i = fire_shot(shot_i, launch_position);
+		/* queue the text in pieces that fit in a draw command */
+		cmd.op = DRAW_TEXT;
+		cmd.row = row;
+		cmd.colour = draw_colour;
+		for(i = 0; i < n && str[i] != '\0'; i += j){
+			for(j = 0; j < CMDTEXT && i+j < n && 
+			    str[i+j] != '\0'; j++){
+				cmd.text[j] = str[i+j];
 			}
-			pthread_mutex_unlock(&shot_mutex);
+			cmd.col = col + i;
+			cmd.len = j;
+			draw_push(&cmd);
+		}
+		return;
+	}
+	
+	/* like curses, anything off the screen is not drawn */
+	if(row < 0 || row >= game->screen_rows){
+		return;
+	}
+	for(i = 0; i < n && str[i] != '\0'; i++){
+		if(col+i >= 0 && col+i < game->screen_cols){
+			game->screen_buf[row*game->screen_cols + col+i] = 
+			    str[i];
+		}
+	}
+}
+
+
+/* 
+ * scr_addch draws one character at (row, col)
+ * expects the position and character, no return value
+ */
+void scr_addch(int row, int col, int c){
+	
+	char ch = c;
+	
+	scr_addnstr(row, col, &ch, 1);
+}
+
+
+/* 
+ * scr_printw draws formatted text at (row, col)
+ * expects the position, a printf format and its arguments, no return value
+ */
+void scr_printw(int row, int col, const char *format, ...){
+	
+	char line[256];
+	va_list args;
+	
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	scr_addnstr(row, col, line, sizeof(line));
+}
+
+
+/* 
+ * scr_colour turns a colour pair on or off for what this thread draws next
+ * expects the colour pair and 1 for on or 0 for off, no return value
+ */
+void scr_colour(int colour, int on){
+	
+	draw_colour = on ? colour : 0;
+}
+
+
+/*
+ * screen_resize moves the game onto a screen of a new size without 
+ * stopping it. saucers and shots that would be off the screen are taken 
+ * out of play without scoring, and only the rows and cells that changed 
+ * are redrawn. draw mutex must be locked before entering
+ * expects the new number of rows and cols, no return value
+ */
+void screen_resize(int rows, int cols){
+	
+	int r, c, i;
+	int old_rows = game->screen_rows;
+	int old_cols = game->screen_cols;
+	char *buf;
+	char *blank;
+	struct saucerprop *saucer;
+	struct shotprop *shot;
+	
+	/* never smaller than the game can be played on, see main */
+	if(rows < saucer_rows + 3){
+		rows = saucer_rows + 3;
+	}
+	if(cols <= 2 * (int)strlen(saucer_shape)){
+		cols = 2 * strlen(saucer_shape) + 1;
+	}
+	if(rows == old_rows && cols == old_cols){
+		return;
+	}
+	
+	blank = malloc(cols > old_cols ? cols : old_cols);
+	if(blank == NULL){
+		fprintf(stderr, "out of memory resizing the screen\n");
+		endwin();
+		exit(-1);
+	}
+	memset(blank, ' ', cols > old_cols ? cols : old_cols);
+	
+	/* keep what is on both the old and new in-memory screens */
+	if(game->headless){
+		buf = malloc(rows * cols);
+		if(buf == NULL){
+			fprintf(stderr, "out of memory resizing the screen\n");
+			exit(-1);
+		}
+		memset(buf, ' ', rows * cols);
+		for(r = 0; r < rows && r < old_rows; r++){
+			memcpy(buf + r * cols, game->screen_buf + r * old_cols, 
+			    cols < old_cols ? cols : old_cols);
+		}
+		free(game->screen_buf);
+		game->screen_buf = buf;
+	}
+	game->screen_rows = rows;
+	game->screen_cols = cols;
+	
+	/* a saucer reaching past the new right edge is taken out of play: */
+	/* its interval is removed and it is replaced as if it had been hit */
+	for(i = 0; cols < old_cols && i < game->saucer_slots.used; i++){
+		saucer = saucer_at(i);
+		if(!saucer->alive || saucer->kill || saucer->span < 0 || 
+		    game->spans[saucer->row].last[saucer->span] < cols - 1){
+			continue;
+		}
+		span_remove(saucer);
+		for(c = saucer->col - 1; c < cols; c++){
+			if(span_count(saucer->row, c) == 0){
+				scr_addch(saucer->row, c, ' ');
+			}
+		}
+		
+		/* with nothing left to clear, the next move replaces it */
+		saucer->col = 0;
+		saucer->len = 0;
+		saucer->kill = 1;
+		if(game->tick_engine){
+			wheel_add(&game->saucer_wheel, &saucer->timer, 1);
+		}
+	}
+	
+	/* a shot below or right of the new screen goes to the top row, so */
+	/* its next move takes it off the screen. it has only been there  */
+	/* from now on, so that move sweeps the top row from now	   */
+	for(i = 0; i < game->shot_slots.used; i++){
+		shot = shot_at(i);
+		if(!shot->alive || (shot->row < rows-2 && shot->col < cols-1)){
+			continue;
+		}
+		if(shot->col >= cols-1){
+			shot->col = cols-2;
+		}
+		shot->row = 0;
+		shot->moved = wheel_now(&game->shot_wheel);
+	}
+	
+	/* the old status and launch site rows are now part of the sky, and */
+	/* the new ones may have had shots drawn on them		    */
+	if(rows > old_rows){
+		scr_addnstr(old_rows-2, 0, blank, old_cols);
+		scr_addnstr(old_rows-1, 0, blank, old_cols);
+	}
+	scr_addnstr(rows-2, 0, blank, cols);
+	scr_addnstr(rows-1, 0, blank, cols);
+	free(blank);
+	
+	/* keep the launch site on the screen and redraw it and the status */
+	if(game->launch_position > cols-4){
+		game->launch_position = cols-4;
+	}
+	scr_addnstr(rows-2, game->launch_position, " | ", 3);
+	draw_stats();
+}
+
+
+/*
+ * slots_grow adds one chunk of free slots to a slot pool. chunks never 
+ * move, so pointers to records stay valid while the pool grows
+ * expects the pool, returns 0 or -1 if the pool is full or out of memory
+ */
+int slots_grow(struct slots *pool){
+	
+	int i;
+	int chunk = pool->cap / CHUNK;
+	int *bigger;
+	struct chunkblock *block;
+	
+	if(chunk == MAXCHUNKS){
+		return -1;
+	}
+	
+	/* the first chunk of a block needs the block */
+	block = pool->blocks[chunk / CHUNKBLOCK];
+	if(block == NULL){
+		block = calloc(1, sizeof(*block));
+		if(block == NULL){
+			return -1;
+		}
+		pool->blocks[chunk / CHUNKBLOCK] = block;
+	}
+	chunk %= CHUNKBLOCK;
+	block->records[chunk] = calloc(CHUNK, pool->size);
+	block->gens[chunk] = calloc(CHUNK, sizeof(atomic_uint));
+	if(block->records[chunk] == NULL || block->gens[chunk] == NULL){
+		free(block->records[chunk]);
+		free(block->gens[chunk]);
+		block->records[chunk] = NULL;
+		block->gens[chunk] = NULL;
+		return -1;
+	}
+	
+	/* the old stack may be freed by realloc, so keep the new one at once */
+	bigger = realloc(pool->free, (pool->cap + CHUNK) * sizeof(int));
+	if(bigger == NULL){
+		free(block->records[chunk]);
+		free(block->gens[chunk]);
+		block->records[chunk] = NULL;
+		block->gens[chunk] = NULL;
+		return -1;
+	}
+	pool->free = bigger;
+	
+	/* push the new slots highest first so the lowest is handed out next */
+	for(i = CHUNK - 1; i >= 0; i--){
+		pool->free[pool->nfree++] = pool->cap + i;
+	}
+	pool->cap += CHUNK;
+	return 0;
+}
+
+
+/*
+ * slots_init grows a slot pool until it holds at least n slots
+ * expects the pool and number of slots, no return value
+ */
+void slots_init(struct slots *pool, int n){
+	
+	while(pool->cap < n){
+		if(slots_grow(pool)){
+			fprintf(stderr, "calloc failed, maybe we ran out of "
+			    "memory\n");
+			exit(-1);
 		}
 	}
-	pthread_exit(retval);
+}
+
+
+/*
+ * slot_alloc takes a free slot from a pool in O(1), growing the pool when 
+ * every slot is in use. draw mutex must be locked before entering
+ * expects the pool, returns the slot index or -1 if the pool is full
+ */
+int slot_alloc(struct slots *pool){
+	
+	int i;
+	
+	if(pool->nfree == 0 && slots_grow(pool)){
+		return -1;
+	}
+	i = pool->free[--pool->nfree];
+	if(i >= pool->used){
+		pool->used = i + 1;
+	}
+	return i;
+}
+
+
+/*
+ * slot_free gives a slot back to its pool in O(1). its generation goes up 
+ * so handles to what used it before no longer match
+ * draw mutex must be locked before entering
+ * expects the pool and slot index, no return value
+ */
+void slot_free(struct slots *pool, int i){
+	
+	atomic_fetch_add(slot_gen(pool, i), 1);
+	pool->free[pool->nfree++] = i;
+}
+
+
+/*
+ * slots_clear frees every slot of a pool, for a new game
+ * the records must no longer be in use
+ * expects the pool, no return value
+ */
+void slots_clear(struct slots *pool){
+	
+	int i;
+	
+	pool->nfree = 0;
+	for(i = pool->cap - 1; i >= 0; i--){
+		atomic_fetch_add(slot_gen(pool, i), 1);
+		memset(slot_get(pool, i), 0, pool->size);
+		pool->free[pool->nfree++] = i;
+	}
+	pool->used = 0;
+}
+
+
+/*
+ * slot_get finds the record for a slot index
+ * expects the pool and slot index, returns the address of the record
+ */
+void *slot_get(struct slots *pool, int i){
+	
+	int chunk = i / CHUNK;
+	
+	return (char *)pool->blocks[chunk / CHUNKBLOCK]->records[chunk % 
+	    CHUNKBLOCK] + (i % CHUNK) * pool->size;
+}
+
+
+/*
+ * slot_gen finds the generation of a slot, see slot_handle
+ * expects the pool and slot index, returns the address of the generation
+ */
+atomic_uint *slot_gen(struct slots *pool, int i){
+	
+	int chunk = i / CHUNK;
+	
+	return &pool->blocks[chunk / CHUNKBLOCK]->gens[chunk % CHUNKBLOCK]
+	    [i % CHUNK];
+}
+
+
+/*
+ * slot_handle names what is in a slot now: its index in the low 32 bits 
+ * and its generation in the high 32 bits
+ * expects the pool and slot index, returns the handle
+ */
+uint64_t slot_handle(struct slots *pool, int i){
+	
+	unsigned gen = atomic_load(slot_gen(pool, i));
+	
+	return (uint64_t)gen << 32 | (uint32_t)i;
+}
+
+
+/*
+ * slot_valid checks whether a handle still names what is in its slot
+ * expects the pool and handle, returns 1 if it has not been freed since
+ */
+int slot_valid(struct slots *pool, uint64_t handle){
+	
+	int i = handle & 0xffffffff;
+	
+	return i < pool->cap && 
+	    atomic_load(slot_gen(pool, i)) == handle >> 32;
+}
+
+
+/*
+ * saucer_at and shot_at find the saucer and shot records for slot indices
+ * expects the slot index, returns the address of the record
+ */
+struct saucerprop *saucer_at(int i){
+	
+	return slot_get(&game->saucer_slots, i);
+}
+
+struct shotprop *shot_at(int i){
+	
+	return slot_get(&game->shot_slots, i);
+}
+
+
+/*
+ * saucer_alloc takes a free saucer slot, leaving the game if there are none
+ * draw mutex must be locked before entering
+ * expects no args, returns the slot index
+ */
+int saucer_alloc(){
+	
+	int i = slot_alloc(&game->saucer_slots);
+	
+	if(i < 0){
+		fprintf(stderr, "out of memory for saucers\n");
+		endwin();
+		exit(-1);
+	}
+	return i;
+}
+
+
+/*
+ * rng_seed seeds a generator with stream n of a seed. the state is four 
+ * outputs of splitmix64 started from the seed and stream mixed together,
+ * which is never all zero
+ * expects the generator, the seed and the stream, no return value
+ */
+void rng_seed(struct rng *r, uint64_t seed, uint64_t n){
+	
+	int i;
+	uint64_t z, x = seed ^ (n * 0xd1342543de82ef95ULL);
+	
+	for(i = 0; i < 4; i++){
+		x += 0x9e3779b97f4a7c15ULL;
+		z = x;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		r->s[i] = (z ^ (z >> 31)) >> 32;
+	}
+}
+
+
+/*
+ * rng_next steps a generator
+ * expects the generator, returns the next 32 random bits
+ */
+uint32_t rng_next(struct rng *r){
+	
+	uint32_t *s = r->s;
+	uint32_t x = s[1] * 5;
+	uint32_t out = ((x << 7) | (x >> 25)) * 9;
+	uint32_t t = s[1] << 9;
+	
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 11) | (s[3] >> 21);
+	return out;
+}
+
+
+/*
+ * rng_below picks a number below n, scaling 32 random bits by n rather 
+ * than taking a remainder
+ * expects the generator and n > 0, returns a number from 0 to n-1
+ */
+int rng_below(struct rng *r, int n){
+	
+	return ((uint64_t)rng_next(r) * n) >> 32;
+}
+
+
+/*
+ * game_seed seeds the calling thread's game with game number n's streams
+ * of a seed, so games seeded alike play alike whatever thread runs them
+ * expects the seed and the game number, no return value
+ */
+void game_seed(unsigned seed, int n){
+	
+	rng_seed(&game->roll, seed, 2 * (uint64_t)n);
+	rng_seed(&game->setup, seed, 2 * (uint64_t)n + 1);
+}
+
+
+/* 
+ * setup_saucer populates the saucer record in slot i
+ * expects integer corresponding to the slot index, no return value
+ */ 
+void setup_saucer(int i){
+	
+	struct saucerprop *info = saucer_at(i);
+
+	trace_event("saucer spawn", i);
+	info->row = rng_below(&game->setup, saucer_rows);
+	info->delay = 1 + rng_below(&game->setup, 15);
+	info->index = i;
+	info->colour = game->next_colour;
+	info->kill = 0;
+	
+	/* start off the left edge with the whole shape showing */
+	info->col = 0;
+	info->len = strlen(saucer_shape);
+	info->span = -1;
+	info->alive = 1;
+	
+	/* one column every (delay) ticks, or when a step of the tick engine */
+	/* is longer than that, enough columns at a time to keep that pace */
+	info->step = (tick_scale + info->delay - 1) / info->delay;
+	info->period = info->step * info->delay;
+	info->born = wheel_now(&game->saucer_wheel);
+	
+	/* the tick engine moves it after (period) ticks, a saucer thread */
+	/* waits on its timer itself and a coroutine starts from the top */
+	info->timer.owner = info;
+	info->timer.due = info->born;
+	info->resume = 0;
+	if(game->tick_engine){
+		wheel_at(&game->saucer_wheel, &info->timer, 
+		    info->born + info->period);
+	}
+	else if(!coroutines){
+		sem_init(&info->timer.wake, 0, 0);
+	}
+	
+	/* loop colours */
+	if(game->next_colour == 6){
+		game->next_colour = 0;
+	}
+	else{
+		game->next_colour ++;
+	}	
+}
+
+
+/* 
+ * draw_stats prints the # of rockets left and # of missed saucers on the 
+ * screen from a snapshot of the counters. draw mutex must be locked before 
+ * entering. the snapshot is taken under draw after the caller's update, so 
+ * the last status line drawn always has the latest counts
+ * expects no args & no return values
+ */
+void draw_stats(){
+
+	struct drawcmd cmd;
+	
+	cmd.op = DRAW_STATUS;
+	cmd.score = atomic_load(&game->score_update);
+	cmd.rockets = atomic_load(&game->shot_update);
+	cmd.escaped = atomic_load(&game->escape_update);
+	
+	/* print message at bottom of the screen */
+	if(game->headless){
+		scr_printw(game->screen_rows-1, 0, STATUS, cmd.score, 
+		    cmd.rockets, cmd.escaped, MAXESCAPE);
+	}
+	else{
+		draw_push(&cmd);
+	}
+}
+
+
+/* 
+ * stats prints the # of rockets left and # of missed saucers on the screen
+ * uses the draw mutex so draw must be unlocked before entering stats
+ * expects no args & no return values
+ */
+void stats(){
+
+	lock_draw();
+	draw_stats();
+	unlock_draw();
+}
+
+
+/* 
+ * launch_site responds to user input that moves the launch site
+ * expects new direction and old position of the shot, returns the new position
+ */
+int launch_site(int direction, int position){
+	
+	/* if we are within the range of the screen move to new position */
+	if(position+direction >= 0 && position+direction < game->screen_cols-3){
+		
+		/* new position */
+		position = direction + position;
+		
+		/* draw new position on screen */
+		lock_draw();
+		scr_addnstr(game->screen_rows-2, position, " | ", 3);
+		unlock_draw();
+	}
+	
+	/* returns old pos if request was out of range, otherwise returns new */
+	return position;
+}
+
+
+/*
+ * clear_saucer draws over a saucer that has been hit and removes its 
+ * interval from its row. draw mutex must be locked before entering
+ * expects the length to draw over, column, saucer record, and a string to 
+ * draw, no return value
+ */
+void clear_saucer(int len, int col, struct saucerprop *info, char *shape){
+	
+	/* draw over the saucer to remove it from the screen */
+	scr_addnstr(info->row, col, shape, len);
+	
+	/* remove saucer position from the collision index */
+	span_remove(info);
+	info->kill = 0;
+}
+
+
+/*
+ * saucer hit updates the collision index after a saucer has been hit
+ * and replaces the saucer thread with a new one
+ * expects the length to remove, column, saucer record, and a string to draw 
+ * no return value
+ */
+void saucer_hit(int len, int col, struct saucerprop *info, char *shape){
+	
+	int index = info->index;
+
+	lock_draw();
+	
+	/* draw over the saucer and remove it from the collision index */
+	clear_saucer(len, col, info, shape);
+	unlock_draw();
+	
+	/* signal to replace the thread at that index */
+	/* replace_thread locks draw while holding replace_mutex */
+	lock_timed(&replace_timing);
+	
+	/* set global to index that can be replaced */
+	game->replace_index = index;
+	pthread_cond_signal(&replace_condition);
+	unlock_timed(&replace_timing);
+}
+
+
+/* 
+ * span_swap swaps two neighbouring intervals of a row and tells their 
+ * saucers where they now are
+ * expects the row's intervals and the lower position, no return value
+ */
+void span_swap(struct rowspans *r, int i){
+	
+	int first = r->first[i];
+	int last = r->last[i];
+	int id = r->id[i];
+	
+	r->first[i] = r->first[i+1];
+	r->last[i] = r->last[i+1];
+	r->id[i] = r->id[i+1];
+	r->first[i+1] = first;
+	r->last[i+1] = last;
+	r->id[i+1] = id;
+	saucer_at(r->id[i])->span = i;
+	saucer_at(id)->span = i + 1;
+}
+
+
+/* 
+ * span_find finds where the intervals of a row starting at or after a 
+ * column begin, by binary search
+ * expects the row's intervals and the column, returns the position
+ */
+int span_find(struct rowspans *r, int col){
+	
+	int lo = 0;
+	int hi = r->n;
+	int mid;
+	
+	while(lo < hi){
+		mid = (lo + hi) / 2;
+		if(r->first[mid] < col){
+			lo = mid + 1;
+		}
+		else{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+
+/* 
+ * span_insert adds a saucer's interval to its row, after any that start 
+ * at the same column. draw mutex must be locked before entering
+ * expects the saucer record and its first and last columns, no return value
+ */
+void span_insert(struct saucerprop *info, int first, int last){
+	
+	int i, n;
+	struct rowspans *r = &game->spans[info->row];
+	
+	/* double the arrays when they are full */
+	if(r->n == r->cap){
+		n = r->cap ? 2 * r->cap : 8;
+		r->first = realloc(r->first, n * sizeof(int));
+		r->last = realloc(r->last, n * sizeof(int));
+		r->id = realloc(r->id, n * sizeof(int));
+		if(r->first == NULL || r->last == NULL || r->id == NULL){
+			fprintf(stderr, "out of memory for saucer intervals\n");
+			endwin();
+			exit(-1);
+		}
+		r->cap = n;
+	}
+	
+	/* move later intervals up one, telling their saucers */
+	i = span_find(r, first + 1);
+	for(n = r->n; n > i; n--){
+		r->first[n] = r->first[n-1];
+		r->last[n] = r->last[n-1];
+		r->id[n] = r->id[n-1];
+		saucer_at(r->id[n])->span = n;
+	}
+	r->first[i] = first;
+	r->last[i] = last;
+	r->id[i] = info->index;
+	r->n ++;
+	info->span = i;
+}
+
+
+/* 
+ * span_remove takes a saucer's interval out of its row, if it has one
+ * draw mutex must be locked before entering
+ * expects the saucer record, no return value
+ */
+void span_remove(struct saucerprop *info){
+	
+	int i;
+	struct rowspans *r = &game->spans[info->row];
+	
+	if(info->span < 0){
+		return;
+	}
+	for(i = info->span; i + 1 < r->n; i++){
+		r->first[i] = r->first[i+1];
+		r->last[i] = r->last[i+1];
+		r->id[i] = r->id[i+1];
+		saucer_at(r->id[i])->span = i;
+	}
+	r->n --;
+	info->span = -1;
+}
+
+
+/* 
+ * span_move moves a saucer's interval along its row in O(1): a saucer 
+ * only moves one column, so it can only pass intervals that started in 
+ * the same column. adds the interval the first time the saucer moves
+ * draw mutex must be locked before entering
+ * expects the saucer record and its new first and last columns
+ * no return value
+ */
+void span_move(struct saucerprop *info, int first, int last){
+	
+	int i = info->span;
+	struct rowspans *r = &game->spans[info->row];
+	
+	if(i < 0){
+		span_insert(info, first, last);
+		return;
+	}
+	r->first[i] = first;
+	r->last[i] = last;
+	while(i + 1 < r->n && r->first[i+1] < first){
+		span_swap(r, i);
+		i ++;
+	}
+}
+
+
+/* 
+ * span_count counts the saucers covering a position, checking only the 
+ * intervals that start close enough to the left of it to reach it
+ * draw mutex must be locked before entering
+ * expects the row and col, returns the number of saucers
+ */
+int span_count(int row, int col){
+	
+	int i;
+	int count = 0;
+	struct rowspans *r;
+	
+	if(row < 0 || row >= saucer_rows){
+		return 0;
+	}
+	r = &game->spans[row];
+	for(i = span_find(r, col - (int)strlen(saucer_shape) + 1); 
+	    i < r->n && r->first[i] <= col; i++){
+		if(r->last[i] >= col){
+			count ++;
+		}
+	}
+	return count;
+}
+
+
+/* 
+ * spans_clear empties every row's intervals, for a new game
+ * expects no args & no return values
+ */
+void spans_clear(){
+	
+	int i;
+	
+	for(i = 0; i < saucer_rows; i++){
+		game->spans[i].n = 0;
+	}
+}
+
+
+/*
+ * spans_init allocates the intervals and stripe of the collision index 
+ * for each of the saucer_rows rows
+ * expects no args & no return values
+ */
+void spans_init(){
+	
+	int i;
+	
+	game->spans = calloc(saucer_rows, sizeof(*game->spans));
+	game->row_mutex = calloc(saucer_rows, sizeof(*game->row_mutex));
+	game->row_timing = calloc(saucer_rows, sizeof(*game->row_timing));
+	if(game->spans == NULL || game->row_mutex == NULL || 
+	    game->row_timing == NULL){
+		fprintf(stderr, "calloc failed, maybe we ran out of memory\n");
+		exit(-1);
+	}
+	for(i = 0; i < saucer_rows; i++){
+		pthread_mutex_init(&game->row_mutex[i], NULL);
+		game->row_timing[i].name = malloc(16);
+		if(game->row_timing[i].name == NULL){
+			fprintf(stderr, "malloc failed, maybe we ran out of "
+			    "memory\n");
+			exit(-1);
+		}
+		snprintf(game->row_timing[i].name, 16, "row %d", i);
+		game->row_timing[i].mutex = &game->row_mutex[i];
+	}
+}
+
+
+/* 
+ * saucer_move draws a saucer one step along its row and moves its interval
+ * in the collision index. draw mutex should be locked before entering
+ * expects the address of the saucer properties
+ * returns 1 once the saucer has moved off the screen, 0 otherwise
+ */
+int saucer_move(struct saucerprop *info){
+	
+	int len = strlen(saucer_shape);
+	int col = info->col;
+	int len2 = info->len;
+	
+	trace_event("saucer move", info->index);
+	
+	/* set colour only if the global use_colour is set to 1 */
+	if(use_colour){
+		
+		/* change colour of terminal */
+		scr_colour(info->colour, 1);
+	}
+	
+	/* if not overlapping */
+	if(span_count(info->row, col) <= 1){
+		
+		/* print the saucer on the screen at (row, col) */
+		scr_addnstr(info->row, col, saucer_shape, len2);
+	}
+	
+	/* if overlapping with another saucer */
+	else{
+		/* print saucer without the padding at the end */
+		scr_addnstr(info->row, col+1, saucer_trim, len2-1);
+	}
+	
+	/* unset colour only if the global use_colour is set to 1 */
+	if(use_colour){
+		
+		/* change colour back to default */
+		scr_colour(info->colour, 0);
+	}
+	
+	/* the saucer now covers the len2 columns after the extra space */
+	span_move(info, col+1, col+len2);
+	
+	/* move to next column */
+	info->col ++;
+	
+	/* when we reach the end of the screen start to stop writing */
+	if (info->col+len >= game->screen_cols){
+		
+		/* @ end - write progressively less of the string */
+		info->len --;
+		
+		/* now the string is off the page */
+		if(info->len == 0){
+			span_remove(info);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/* 
+ * saucer_escape updates the score after a saucer has moved off the screen
+ * draw mutex must be locked when using the tick engine and unlocked otherwise
+ * returns 1 for the saucer that makes too many escaped, 0 otherwise
+ */
+int saucer_escape(){
+	
+	int escaped = atomic_fetch_add(&game->escape_update, 1) + 1;
+	
+	trace_event("saucer escape", -1);
+	
+	if(game->tick_engine){
+		draw_stats();
+	}
+	else{
+		stats();
+	}
+	
+	/* if we have reached the max escaped saucers, which a stress run */
+	/* carries on past */
+	return !stress && escaped == MAXESCAPE;
+}
+
+
+/* 
+ * saucers is the function used by all the saucer threads
+ * is type void* and recieves argument void* b/c requirements of pthread_create
+ * expects the start the address of the corresponding saucer properties
+ * no return value
+ */
+void *saucers(void *properties){	
+	
+	int escaped;
+	
+	/* points to properties info for a specific saucer */
+	struct saucerprop *info = properties;
+	
+	/* update the saucers */
+	while(1){
+		
+		/* remove the saucer if kill is set for that saucer */
+		if(info->kill == 1){
+		
+			/* remove saucer info */
+			saucer_hit(info->len, info->col, info, saucer_blank);
+		
+			/* finish with the thread */
+			pthread_exit(NULL);
+		}
+		
+		/* thread sleeps for (its delay time) ticks of the timer */
+		/* wheel counted from when it was last due, so it keeps to */
+		/* schedule						   */
+		timer_sleep(&game->saucer_wheel, &info->timer, 
+		    info->timer.due + info->period);
+		
+		/* CRITICAL REGION BELOW: only this row's intervals are */
+		/* used, so saucers on other rows move at the same time */
+		lock_draw_shared();
+		lock_row(info->row);
+		escaped = saucer_move(info);
+		unlock_row(info->row);
+		unlock_draw_shared();
+		
+		/* now the string is off the page, exit the thread */
+		if(escaped){
+
+			/* update the score now that a saucer escaped */
+			if(saucer_escape()){
+				
+				/* send signal to the main function */
+				lock_timed(&end_timing);
+				pthread_cond_signal(&end_condition);
+				unlock_timed(&end_timing);
+				
+				/* we are done with the thread now */
+				pthread_exit(NULL);
+			}
+			
+			/* signal that the thread can be replaced */
+			lock_timed(&replace_timing);
+			
+			/* set global to index that can be replaced */
+			game->replace_index = info->index;
+			pthread_cond_signal(&replace_condition);
+			unlock_timed(&replace_timing);
+			
+			/* now we are finished with the thread */
+			pthread_exit(NULL);
+		}	
+	}
+}
+
+
+/* 
+ * saucer_co is the coroutine engine's saucer: the loop of saucers, with 
+ * each wait for its timer a CO_SLEEP, run a move at a time by a scheduler 
+ * thread. it replaces itself where the thread would signal replace_thread
+ * expects the address of the saucer properties, no return value
+ */
+void saucer_co(void *properties){
+	
+	int escaped;
+	struct saucerprop *info = properties;
+	
+	CO_BEGIN(info);
+	while(1){
+		
+		/* remove the saucer if kill is set for that saucer */
+		if(info->kill == 1){
+			lock_draw();
+			clear_saucer(info->len, info->col, info, saucer_blank);
+			unlock_draw();
+			saucer_restart(info);
+			return;
+		}
+		
+		/* give the scheduler back until (its delay time) ticks later */
+		CO_SLEEP(info, &game->saucer_wheel, 
+		    info->timer.due + info->period);
+		
+		/* CRITICAL REGION BELOW: as in saucers */
+		lock_draw_shared();
+		lock_row(info->row);
+		escaped = saucer_move(info);
+		unlock_row(info->row);
+		unlock_draw_shared();
+		
+		if(escaped){
+			
+			/* too many escaped: send signal to the main function */
+			if(saucer_escape()){
+				lock_timed(&end_timing);
+				pthread_cond_signal(&end_condition);
+				unlock_timed(&end_timing);
+				return;
+			}
+			saucer_restart(info);
+			return;
+		}
+	}
+	CO_END;
+}
+
+
+/* 
+ * saucer_restart frees a finished coroutine saucer's slot and starts a new 
+ * saucer in a free slot, which may be the same record, so the caller must
+ * return without touching it again
+ * expects the address of the saucer properties, no return value
+ */
+void saucer_restart(struct saucerprop *info){
+	
+	int i;
+	
+	lock_draw();
+	slot_free(&game->saucer_slots, info->index);
+	i = saucer_alloc();
+	setup_saucer(i);
+	info = saucer_at(i);
+	unlock_draw();
+	
+	/* runs until its first CO_SLEEP */
+	saucer_co(info);
+}
+
+
+/* 
+ * start_saucer takes a free saucer slot, populates it and puts the saucer 
+ * in play, either by creating its thread or by handing it to the tick loop
+ * expects no args, no return value
+ */
+void start_saucer(){
+	
+	int i;
+	struct saucerprop *info;
+	
+	/* slots are handed out and the tick loop reads them under draw */
+	lock_draw();
+	i = saucer_alloc();
+	setup_saucer(i);
+	unlock_draw();
+	
+	if(game->tick_engine){
+		return;
+	}
+	
+	/* a coroutine runs until its first CO_SLEEP */
+	info = saucer_at(i);
+	if(coroutines){
+		saucer_co(info);
+		return;
+	}
+	
+	/* create a saucer thread */
+	if (pthread_create(&info->thread, NULL, saucers, info)){
+		fprintf(stderr,"error creating saucer thread\n");
+		endwin();
+		exit(-1);
+	}
+	info->has_thread = 1;
+}
+
+
+/* 
+ * rand_saucers adds a new saucer 
+ * expects the current number of active saucers, returns the new number saucers
+ */
+int rand_saucers(int n){
+	
+	/* populate a saucer slot and put the saucer in play */
+	start_saucer();
+		
+	/* new number of saucers */
+	n ++;
+	return n;
+}
+
+
+/*
+ * replace_thread is run constantly by one thread
+ * it replaces a saucer thread that has finished running with a new saucer 
+ * allows many threads to be created but only a fixed number of active threads
+ * and a set amount of threads to be stored in an array
+ * expects no args & no return values
+ */
+void *replace_thread(){
+	
+	void *retval;
+	int i;
+	struct saucerprop *info;
+	
+	while(1){
+
+		/* wait until given the signal to replace a thread */
+		lock_timed(&replace_timing);
+		wait_timed(&replace_condition, &replace_timing);
+
+		/* wait until thread terminates for sure before replacing it */
+		info = saucer_at(game->replace_index);
+		pthread_join(info->thread, &retval);
+	
+		/* optional delay */
+	 	/* sleep(2); */
+	
+		/* populate new saucer + create new thread in a new slot */
+		lock_draw();
+		info->has_thread = 0;
+		slot_free(&game->saucer_slots, info->index);
+		i = saucer_alloc();
+		setup_saucer(i);
+		unlock_draw();
+		
+		info = saucer_at(i);
+		if(pthread_create(&info->thread, NULL, saucers, info)){
+			fprintf(stderr,"error replacing saucer thread\n");
+			endwin();
+			exit(-1);
+		}
+		info->has_thread = 1;
+		unlock_timed(&replace_timing);
+	}
+}
+
+
+/*
+ * wheel_init empties a timer wheel and starts it at tick 0
+ * expects the wheel, no return value
+ */
+void wheel_init(struct wheel *w){
+	
+	int level, slot;
+	struct timer *head;
+	
+	w->now = 0;
+	for(level = 0; level < WHEELLEVELS; level++){
+		w->busy[level] = 0;
+		for(slot = 0; slot < WHEELSIZE; slot++){
+			head = &w->slots[level][slot];
+			head->next = head;
+			head->prev = head;
+		}
+	}
+}
+
+
+/*
+ * wheel_insert links a timer into the slot for its due tick: level 0 if 
+ * it is due within WHEELSIZE ticks, otherwise the lowest level that 
+ * reaches that far. timers due past the top level wait in its last slot.
+ * a timer cascaded down as its tick comes round is due now, and goes in 
+ * this tick's slot of level 0, which wheel_advance empties next
+ * the wheel's lock must be held, expects the wheel and timer, no return value
+ */
+void wheel_insert(struct wheel *w, struct timer *t){
+	
+	int slot;
+	int level = 0;
+	long due = t->due;
+	struct timer *head;
+	
+	if(due - w->now >= 1L << (WHEELLEVELS * WHEELBITS)){
+		due = w->now + (1L << (WHEELLEVELS * WHEELBITS)) - 1;
+	}
+	while(level < WHEELLEVELS - 1 && 
+	    due - w->now >= 1L << ((level + 1) * WHEELBITS)){
+		level ++;
+	}
+	
+	/* add at the tail so timers due together run in the order added */
+	slot = (due >> (level * WHEELBITS)) & (WHEELSIZE - 1);
+	head = &w->slots[level][slot];
+	w->busy[level] |= 1ULL << slot;
+	t->next = head;
+	t->prev = head->prev;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+
+/*
+ * timer_remove takes a timer off its wheel if it is on one, in O(1)
+ * the wheel's lock must be held, expects the timer, no return value
+ */
+void timer_remove(struct timer *t){
+	
+	if(t->prev){
+		t->prev->next = t->next;
+		t->next->prev = t->prev;
+		t->next = NULL;
+		t->prev = NULL;
+	}
+}
+
+
+/*
+ * wheel_at schedules a timer for a given tick, moving it if it was already 
+ * scheduled. a tick already passed becomes the next one
+ * the wheel's lock must be held
+ * expects the wheel, timer and tick, no return value
+ */
+void wheel_at(struct wheel *w, struct timer *t, long due){
+	
+	timer_remove(t);
+	t->due = (due <= w->now) ? w->now + 1 : due;
+	wheel_insert(w, t);
+}
+
+
+/*
+ * wheel_add schedules a timer a number of ticks after the wheel's current 
+ * tick, moving it if it was already scheduled
+ * the wheel's lock must be held
+ * expects the wheel, timer and number of ticks, no return value
+ */
+void wheel_add(struct wheel *w, struct timer *t, long ticks){
+	
+	wheel_at(w, t, w->now + ticks);
+}
+
+
+/*
+ * wheel_now reads a wheel's current tick. the tick engine only changes its
+ * wheels under the draw mutex, the timer thread under timer_mutex
+ * expects the wheel, returns the tick
+ */
+long wheel_now(struct wheel *w){
+	
+	long now;
+	
+	if(game->tick_engine){
+		return w->now;
+	}
+	lock_timed(&timer_timing);
+	now = w->now;
+	unlock_timed(&timer_timing);
+	return now;
+}
+
+
+/*
+ * wheel_window moves a timer wheel on by one step of the tick engine, that 
+ * is tick_scale ticks. the wheel's lock must be held, expects the wheel
+ * returns the timers due during the step in the order they came due, as a
+ * list joined by next, or NULL if none
+ */
+struct timer *wheel_window(struct wheel *w){
+	
+	int i;
+	struct timer *due = NULL, **tail = &due;
+	
+	for(i = 0; i < tick_scale; i++){
+		*tail = wheel_advance(w);
+		while(*tail != NULL){
+			tail = &(*tail)->next;
+		}
+	}
+	return due;
+}
+
+
+/*
+ * wheel_advance moves a timer wheel on one tick. when a level's slot comes
+ * round its timers are cascaded down a level, highest level first
+ * the wheel's lock must be held, expects the wheel
+ * returns the timers now due as a list joined by next, or NULL if none
+ */
+struct timer *wheel_advance(struct wheel *w){
+	
+	int level, slot;
+	struct timer *head, *t, *next, *due = NULL, **tail = &due;
+	
+	w->now ++;
+	for(level = WHEELLEVELS - 1; level > 0; level--){
+		slot = (w->now >> (level * WHEELBITS)) & (WHEELSIZE - 1);
+		if(w->now & ((1L << (level * WHEELBITS)) - 1) || 
+		    !(w->busy[level] & 1ULL << slot)){
+			continue;
+		}
+		
+		/* empty the slot then put each timer back nearer to its tick */
+		head = &w->slots[level][slot];
+		w->busy[level] &= ~(1ULL << slot);
+		t = head->next;
+		head->next = head;
+		head->prev = head;
+		while(t != head){
+			next = t->next;
+			wheel_insert(w, t);
+			t = next;
+		}
+	}
+	
+	/* unlink everything in this tick's slot, keeping the order added */
+	slot = w->now & (WHEELSIZE - 1);
+	if(!(w->busy[0] & 1ULL << slot)){
+		return NULL;
+	}
+	w->busy[0] &= ~(1ULL << slot);
+	head = &w->slots[0][slot];
+	for(t = head->next; t != head; t = next){
+		next = t->next;
+		t->prev = NULL;
+		*tail = t;
+		tail = &t->next;
+	}
+	*tail = NULL;
+	head->next = head;
+	head->prev = head;
+	return due;
+}
+
+
+/*
+ * timer_set puts a saucer or shot's timer on a wheel of the threaded engine
+ * expects the wheel, timer and the tick it is due at, no return value
+ */
+void timer_set(struct wheel *w, struct timer *t, long due){
+	
+	lock_timed(&timer_timing);
+	wheel_at(w, t, due);
+	unlock_timed(&timer_timing);
+}
+
+
+/*
+ * timer_sleep is used by saucer and shot threads in place of sleeping: it 
+ * puts the thread's timer on a wheel and waits until timer_thread wakes it
+ * expects the wheel, timer and the tick to wake at, no return value
+ */
+void timer_sleep(struct wheel *w, struct timer *t, long due){
+	
+	timer_set(w, t, due);
+	
+	/* retry if a signal interrupts the wait */
+	while(sem_wait(&t->wake)){
+	}
+}
+
+
+/*
+ * timer_thread is run by a single thread with the threaded engine
+ * once every TICK microseconds, measured from an absolute deadline so it 
+ * does not drift, it wakes every saucer and shot thread that is due, or 
+ * hands each coroutine that is due to the scheduler threads
+ * expects no args & no return values
+ */
+void *timer_thread(){
+	
+	struct timespec next;
+	struct timer *t, *after;
+	
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while(1){
+		sleep_until(&next, TICK);
+		
+		/* a woken thread can not put its timer back until we unlock */
+		lock_timed(&timer_timing);
+		for(t = wheel_advance(&game->saucer_wheel); t != NULL; 
+		    t = after){
+			after = t->next;
+			if(coroutines){
+				pool_push(saucer_co, t->owner);
+			}
+			else{
+				sem_post(&t->wake);
+			}
+		}
+		for(t = wheel_advance(&game->shot_wheel); t != NULL; t = after){
+			after = t->next;
+			if(coroutines){
+				pool_push(shot_co, t->owner);
+			}
+			else{
+				sem_post(&t->wake);
+			}
+		}
+		unlock_timed(&timer_timing);
+	}
+}
+
+
+/*
+ * saucer_reach finds the columns a saucer covered at some time during a 
+ * window of ticks. a saucer moves step columns every period ticks from 
+ * when it was born, so where it was at each end of the window follows 
+ * from that, never past where it is now. draw mutex must be locked
+ * expects the saucer record, the first and last tick of the window and 
+ * where to store the columns, returns 0 if it was not on the screen yet
+ */
+int saucer_reach(struct saucerprop *info, long from, long to, 
+    int *first, int *last){
+	
+	long a = 0;
+	long b = 0;
+	struct rowspans *r = &game->spans[info->row];
+	
+	if(from > info->born){
+		a = info->step * ((from - info->born) / info->period);
+	}
+	if(to > info->born){
+		b = info->step * ((to - info->born) / info->period);
+	}
+	
+	/* a thread that woke late is behind its schedule */
+	if(b > r->first[info->span]){
+		b = r->first[info->span];
+	}
+	if(a > b){
+		a = b;
+	}
+	if(b < 1){
+		return 0;
+	}
+	
+	/* saucers only move right: the window covers from where it was at */
+	/* the start to where it was at the end, less any past the edge    */
+	*first = a < 1 ? 1 : a;
+	*last = b + strlen(saucer_shape) - 1;
+	if(*last > r->last[info->span]){
+		*last = r->last[info->span];
+	}
+	return 1;
+}
+
+
+/*
+ * sweep_hits finds the saucers that were at a position at some time during 
+ * a window of ticks, and can set kill for them. a rocket tested this way 
+ * can not pass through a saucer however far either moves between tests
+ * NOTE: must have draw mutex locked before entering function 
+ * expects row, col, the first and last tick of the window, and 1 to mark 
+ * the saucers hit, returns the number of saucers
+ */
+int sweep_hits(int row, int col, long from, long to, int mark){
+	int i, first, last, reach; 
+	int hits = 0;
+	struct rowspans *r;
+	struct saucerprop *info;
+	
+	if(row < 0 || row >= saucer_rows){
+		return 0;
+	}
+	r = &game->spans[row];
+	
+	/* intervals starting further left than a saucer is long can't reach */
+	/* and those further right than a saucer can move since from weren't */
+	/* there yet. a saucer moves at most a column a tick, or a step	     */
+	reach = wheel_now(&game->saucer_wheel) - from + tick_scale;
+	for(i = span_find(r, col - (int)strlen(saucer_shape) + 1); 
+	    i < r->n && r->first[i] <= col + reach; i++){
+		info = saucer_at(r->id[i]);
+		
+		/* a saucer already hit is only waiting to be removed */
+		if(info->kill || 
+		    !saucer_reach(info, from, to, &first, &last) || 
+		    col < first || col > last){
+			continue;
+		}
+		
+		/* keep track of how many saucers were hit */
+		hits ++;
+		if(!mark){
+			continue;
+		}
+		info->kill = 1;
+		trace_event("saucer hit", info->index);
+		
+		/* the tick engine removes hit saucers on the next tick */
+		if(game->tick_engine){
+			wheel_add(&game->saucer_wheel, &info->timer, 1);
+		}
+	}
+	return hits;
+}
+
+
+/*
+ * mark_hits sets kill for every saucer that was at a given position during
+ * a window of ticks, see sweep_hits
+ * NOTE: must have draw mutex locked before entering function 
+ * expects row, col and the first and last tick of the window
+ * returns the number of saucers hit
+ */
+int mark_hits(int row, int col, long from, long to){
+	
+	return sweep_hits(row, col, from, to, 1);
+}
+
+
+/*
+ * hits_scalar, hits_sse2 and hits_avx2 count, for each of a number of 
+ * columns, the intervals lo[i]..hi[i] covering it. they look at every 
+ * interval, 1, 8 or 16 at a time, so padding has lo above hi
+ * expects the intervals, how many as a multiple of 16, the columns, how 
+ * many, and where to store the counts, no return value
+ */
+void hits_scalar(const int16_t *lo, const int16_t *hi, int n, 
+    const int16_t *cols, int ncols, int *counts){
+	
+	int i, k;
+	
+	for(k = 0; k < ncols; k++){
+		counts[k] = 0;
+		for(i = 0; i < n; i++){
+			counts[k] += lo[i] <= cols[k] && cols[k] <= hi[i];
+		}
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+void hits_sse2(const int16_t *lo, const int16_t *hi, int n, 
+    const int16_t *cols, int ncols, int *counts){
+	
+	int i, k;
+	__m128i col, out;
+	
+	for(k = 0; k < ncols; k++){
+		col = _mm_set1_epi16(cols[k]);
+		counts[k] = 0;
+		for(i = 0; i < n; i += 8){
+			
+			/* each int16 sets two bits of the mask when it */
+			/* does not cover the column			*/
+			out = _mm_or_si128(_mm_cmpgt_epi16(
+			    _mm_loadu_si128((void *)(lo + i)), col),
+			    _mm_cmpgt_epi16(col, 
+			    _mm_loadu_si128((void *)(hi + i))));
+			counts[k] += 8 - 
+			    __builtin_popcount(_mm_movemask_epi8(out)) / 2;
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+void hits_avx2(const int16_t *lo, const int16_t *hi, int n, 
+    const int16_t *cols, int ncols, int *counts){
+	
+	int i, k;
+	__m256i col, out;
+	
+	for(k = 0; k < ncols; k++){
+		col = _mm256_set1_epi16(cols[k]);
+		counts[k] = 0;
+		for(i = 0; i < n; i += 16){
+			out = _mm256_or_si256(
+			    _mm256_cmpgt_epi16(
+			    _mm256_loadu_si256((void *)(lo + i)), col),
+			    _mm256_cmpgt_epi16(col, 
+			    _mm256_loadu_si256((void *)(hi + i))));
+			counts[k] += 16 - 
+			    __builtin_popcount(_mm256_movemask_epi8(out)) / 2;
+		}
+	}
+}
+#else
+void hits_sse2(const int16_t *lo, const int16_t *hi, int n, 
+    const int16_t *cols, int ncols, int *counts){
+	
+	hits_scalar(lo, hi, n, cols, ncols, counts);
+}
+
+void hits_avx2(const int16_t *lo, const int16_t *hi, int n, 
+    const int16_t *cols, int ncols, int *counts){
+	
+	hits_scalar(lo, hi, n, cols, ncols, counts);
+}
+#endif
+
+
+/*
+ * hits_pick chooses the batch hit test for the CPU the game is running on
+ * expects no args, returns hits_avx2, hits_sse2 or hits_scalar
+ */
+void (*hits_pick())(){
+	
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")){
+		return hits_avx2;
+	}
+	if(__builtin_cpu_supports("sse2")){
+		return hits_sse2;
+	}
+#endif
+	return hits_scalar;
+}
+
+
+/*
+ * batch_grow makes room in the hit test batch for more rockets and tests
+ * expects how many more of each, no return value
+ */
+void batch_grow(int shots, int tests){
+	
+	int n;
+	struct hitbatch *b = &game->batch;
+	
+	if(b->nshots + shots >= b->shotcap){
+		n = 2 * (b->nshots + shots) + 16;
+		b->shots = realloc(b->shots, n * sizeof(*b->shots));
+		b->first = realloc(b->first, (n + 1) * sizeof(int));
+		b->shotcap = n;
+		if(b->shots == NULL || b->first == NULL){
+			fprintf(stderr, "out of memory for hit tests\n");
+			endwin();
+			exit(-1);
+		}
+	}
+	if(b->ntests + tests > b->testcap){
+		n = 2 * (b->ntests + tests) + 16;
+		b->rows = realloc(b->rows, n * sizeof(int));
+		b->cols = realloc(b->cols, n * sizeof(int));
+		b->from = realloc(b->from, n * sizeof(long));
+		b->to = realloc(b->to, n * sizeof(long));
+		b->counts = realloc(b->counts, n * sizeof(int));
+		b->order = realloc(b->order, n * sizeof(int));
+		b->probe = realloc(b->probe, n * sizeof(int16_t));
+		b->found = realloc(b->found, n * sizeof(int));
+		b->testcap = n;
+		if(b->rows == NULL || b->cols == NULL || b->from == NULL || 
+		    b->to == NULL || b->counts == NULL || b->order == NULL || 
+		    b->probe == NULL || b->found == NULL){
+			fprintf(stderr, "out of memory for hit tests\n");
+			endwin();
+			exit(-1);
+		}
+	}
+}
+
+
+/*
+ * batch_compare orders two tests by row then window, for qsort, so tests 
+ * that can share the saucers' intervals are next to each other
+ * expects pointers to the two test numbers, returns <0, 0 or >0
+ */
+int batch_compare(const void *a, const void *b){
+	
+	int i = *(const int *)a;
+	int j = *(const int *)b;
+	
+	if(game->batch.rows[i] != game->batch.rows[j]){
+		return game->batch.rows[i] - game->batch.rows[j];
+	}
+	if(game->batch.from[i] != game->batch.from[j]){
+		return game->batch.from[i] < game->batch.from[j] ? -1 : 1;
+	}
+	if(game->batch.to[i] != game->batch.to[j]){
+		return game->batch.to[i] < game->batch.to[j] ? -1 : 1;
+	}
+	return i - j;
+}
+
+
+/*
+ * hits_reach fills batch.lo and batch.hi with the columns each saucer of a
+ * row covered during a window, see saucer_reach. saucers already hit, or 
+ * not yet on the screen, cover nothing. columns are clamped to int16_t, 
+ * which only changes columns no rocket is at, see hits_batch
+ * draw mutex must be locked
+ * expects the row and the first and last tick of the window
+ * returns the number of intervals, padded to a multiple of 16
+ */
+int hits_reach(int row, long from, long to){
+	
+	int i, first, last;
+	int n = (game->spans[row].n + 15) & ~15;
+	struct saucerprop *info;
+	struct hitbatch *b = &game->batch;
+	
+	if(n > b->spancap){
+		b->lo = realloc(b->lo, n * sizeof(int16_t));
+		b->hi = realloc(b->hi, n * sizeof(int16_t));
+		if(b->lo == NULL || b->hi == NULL){
+			fprintf(stderr, "out of memory for hit tests\n");
+			endwin();
+			exit(-1);
+		}
+		b->spancap = n;
+	}
+	for(i = 0; i < n; i++){
+		b->lo[i] = INT16_MAX;
+		b->hi[i] = INT16_MIN;
+		if(i >= game->spans[row].n){
+			continue;
+		}
+		info = saucer_at(game->spans[row].id[i]);
+		if(!info->kill && saucer_reach(info, from, to, &first, &last)){
+			b->lo[i] = first < INT16_MIN ? INT16_MIN : first;
+			b->hi[i] = last > INT16_MAX ? INT16_MAX : last;
+		}
+	}
+	return n;
+}
+
+
+/*
+ * batch_tests lists the hit tests of every rocket in batch.shots: every 
+ * row each one sweeps, in the order shot_move sweeps them, with a count 
+ * of 0. a rocket no longer in play has none
+ * expects no args & no return values
+ */
+void batch_tests(){
+	
+	int i, j, k, rows;
+	struct shotprop *info;
+	struct hitbatch *b = &game->batch;
+	
+	b->ntests = 0;
+	batch_grow(1, 0);
+	for(i = 0; i < b->nshots; i++){
+		info = b->shots[i];
+		b->first[i] = b->ntests;
+		if(!info->alive){
+			continue;
+		}
+		rows = shot_rows(info);
+		batch_grow(0, rows + 1);
+		for(j = 0; j <= rows; j++){
+			k = b->ntests++;
+			b->rows[k] = info->row - j;
+			b->cols[k] = info->col;
+			shot_window(info, j, rows, &b->from[k], &b->to[k]);
+			b->counts[k] = 0;
+		}
+	}
+	b->first[b->nshots] = b->ntests;
+}
+
+
+/*
+ * hits_batch makes the hit tests of every rocket in batch.shots before 
+ * any of them moves, with hits_kernel. the tests are sorted so each row 
+ * and window has its saucers' intervals worked out once, and all the 
+ * columns tested there are counted in one call. a count of 0 means 
+ * shot_move can skip that row. a count above 0 is only a maybe, as a 
+ * rocket moved earlier in the step can hit those saucers first, so 
+ * shot_move tests it again and the same saucers are hit as without -b.
+ * the kernels test int16_t columns, so on a screen wider than INT16_MAX 
+ * each test is swept with sweep_hits instead
+ * draw mutex must be locked before entering
+ * expects no args & no return values
+ */
+void hits_batch(){
+	
+	int i, j, k, n, start;
+	struct hitbatch *b = &game->batch;
+	
+	batch_tests();
+	if(game->screen_cols > INT16_MAX){
+		for(i = 0; i < b->ntests; i++){
+			b->counts[i] = sweep_hits(b->rows[i], b->cols[i], 
+			    b->from[i], b->to[i], 0);
+		}
+		return;
+	}
+	
+	/* only rows with saucers need testing */
+	for(i = 0, n = 0; i < b->ntests; i++){
+		if(b->rows[i] >= 0 && b->rows[i] < saucer_rows && 
+		    game->spans[b->rows[i]].n > 0){
+			b->order[n++] = i;
+		}
+	}
+	qsort(b->order, n, sizeof(int), batch_compare);
+	
+	/* one kernel call for each run of tests with the same row and window */
+	for(start = 0; start < n; start = i){
+		k = b->order[start];
+		for(i = start; i < n && b->rows[b->order[i]] == b->rows[k] && 
+		    b->from[b->order[i]] == b->from[k] && 
+		    b->to[b->order[i]] == b->to[k]; i++){
+			b->probe[i - start] = b->cols[b->order[i]];
+		}
+		hits_kernel(b->lo, b->hi, hits_reach(b->rows[k], b->from[k], 
+		    b->to[k]), b->probe, i - start, b->found);
+		for(j = start; j < i; j++){
+			b->counts[b->order[j]] = b->found[j - start];
+		}
+	}
+}
+
+
+/*
+ * hits_bench times the batch hit test against testing each rocket on its
+ * own, as sweep_hits does: a binary search for the first interval that 
+ * could reach it then a scan. rows of random saucers of several sizes are
+ * each tested with the same random columns, and the counts checked equal
+ * expects no args & no return values
+ */
+void hits_bench(){
+	
+	static int sizes[] = {4, 16, 64, 256, 1024, 0};
+	int s, i, k, n, reps, pad, cols;
+	int width = strlen(saucer_shape) - 1;
+	int tests = 4096;
+	int16_t *probe = malloc(tests * sizeof(int16_t));
+	int *want = malloc(tests * sizeof(int));
+	int *got = malloc(tests * sizeof(int));
+	long start, ns;
+	struct rowspans r;
+	struct rng rng;
+	struct hitbatch *b = &game->batch;
+	struct {
+		char *name;
+		void (*kernel)();
+	} kernels[] = {
+		{"scalar", hits_scalar}, {"sse2", hits_sse2}, 
+		{"avx2", hits_avx2}, {NULL, NULL}
+	};
+	
+	if(probe == NULL || want == NULL || got == NULL){
+		fprintf(stderr, "malloc failed, maybe we ran out of memory\n");
+		exit(-1);
+	}
+	rng_seed(&rng, 1, 0);
+	printf("%-9s %8s %12s %12s\n", "saucers", "test", "ns/rocket", 
+	    "speedup");
+	for(s = 0; sizes[s] != 0; s++){
+		n = sizes[s];
+		pad = (n + 15) & ~15;
+		cols = 4 * n + 80;
+		r.n = n;
+		r.first = malloc(n * sizeof(int));
+		r.last = malloc(n * sizeof(int));
+		b->lo = realloc(b->lo, pad * sizeof(int16_t));
+		b->hi = realloc(b->hi, pad * sizeof(int16_t));
+		if(r.first == NULL || r.last == NULL || b->lo == NULL || 
+		    b->hi == NULL){
+			fprintf(stderr, "malloc failed, maybe we ran out of "
+			    "memory\n");
+			exit(-1);
+		}
+		
+		/* a row of saucers sorted by first column, like spans */
+		for(i = 0; i < n; i++){
+			r.first[i] = rng_below(&rng, cols);
+		}
+		for(i = 1; i < n; i++){
+			for(k = i; k > 0 && r.first[k-1] > r.first[k]; k--){
+				int tmp = r.first[k];
+				r.first[k] = r.first[k-1];
+				r.first[k-1] = tmp;
+			}
+		}
+		for(i = 0; i < pad; i++){
+			b->lo[i] = i < n ? r.first[i] : INT16_MAX;
+			b->hi[i] = i < n ? r.first[i] + width : INT16_MIN;
+			if(i < n){
+				r.last[i] = r.first[i] + width;
+			}
+		}
+		for(k = 0; k < tests; k++){
+			probe[k] = rng_below(&rng, cols);
+		}
+		
+		/* enough repeats to take a few milliseconds at any size */
+		reps = 1 + 2000000 / (tests * (n + 8));
+		start = now_ns();
+		for(i = 0; i < reps; i++){
+			for(k = 0; k < tests; k++){
+				int j, count = 0;
+				
+				for(j = span_find(&r, probe[k] - width); 
+				    j < n && r.first[j] <= probe[k]; j++){
+					count += r.last[j] >= probe[k];
+				}
+				want[k] = count;
+			}
+		}
+		ns = now_ns() - start;
+		printf("%-9d %8s %12.2f %12s\n", n, "search", 
+		    (double)ns / reps / tests, "1.00");
+		for(i = 0; kernels[i].name != NULL; i++){
+			if(kernels[i].kernel == hits_avx2 && 
+			    hits_kernel != hits_avx2){
+				continue;
+			}
+			start = now_ns();
+			for(k = 0; k < reps; k++){
+				kernels[i].kernel(b->lo, b->hi, pad, probe, 
+				    tests, got);
+			}
+			printf("%-9d %8s %12.2f %12.2f%s\n", n, 
+			    kernels[i].name, 
+			    (double)(now_ns() - start) / reps / tests, 
+			    (double)ns / (now_ns() - start),
+			    memcmp(want, got, tests * sizeof(int)) ? 
+			    " MISMATCH" : "");
+		}
+		free(r.first);
+		free(r.last);
+	}
+	free(probe);
+	free(want);
+	free(got);
+}
+
+
+/*
+ * add_hits adds 1 point to the score+shots for every saucer hit
+ * draw mutex must be locked when using the tick engine and unlocked otherwise
+ * expects the number of hits, returns nothing
+ */
+void add_hits(int hits){
+	
+	/* add one point to the score and reward a hit with more shots */
+	atomic_fetch_add(&game->score_update, hits);
+	atomic_fetch_add(&game->shot_update, hits);
+	if(game->tick_engine){
+		draw_stats();
+	}
+	else{
+		stats();
+	}
+}
+
+
+/*
+ * reserve_rocket takes one rocket if there are any left, without locking
+ * expects no args, returns 1 if a rocket was taken and 0 if there were none
+ */
+int reserve_rocket(){
+	
+	int left = atomic_load(&game->shot_update);
+	
+	/* on failure left is reloaded with the current count and we try */
+	/* again							  */
+	while(left > 0){
+		if(atomic_compare_exchange_weak(&game->shot_update, &left, 
+		    left - 1)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * find hit locates hit saucers, draws over a shot at a given position,
+ * and adds 1 point to the score+shots
+ * NOTE: must have draw locked shared before entering function 
+ * expects row, col and the ticks the shot was there, returns nothing
+ */
+void find_hit(int row, int col, long from, long to){
+	int hits;
+	
+	lock_row(row);
+	hits = mark_hits(row, col, from, to);
+	unlock_row(row);
+	unlock_draw_shared();
+	
+	/* update the score */
+	add_hits(hits);
+}
+
+
+/* 
+ * shot_rows finds how many rows a shot moves when it is next due, going 
+ * no further than the one above the top
+ * expects the address of the shot properties, returns the number of rows
+ */
+int shot_rows(struct shotprop *info){
+	
+	return info->step < info->row + 1 ? info->step : info->row + 1;
+}
+
+
+/* 
+ * shot_window finds the ticks a moving shot spent on the jth row it 
+ * sweeps: the row it has been on since it last moved, then SHOTTICKS 
+ * ticks for each row it passes in a step, then the row it reaches now
+ * expects the address of the shot properties, the row, the number of rows
+ * moved and where to store the first and last tick, no return value
+ */
+void shot_window(struct shotprop *info, int j, int rows, long *from, 
+    long *to){
+	
+	long now = info->timer.due;
+	
+	if(j == rows){
+		*from = now;
+		*to = now;
+	}
+	else{
+		*from = info->moved + j * SHOTTICKS;
+		*to = (j == rows - 1) ? now : *from + SHOTTICKS;
+	}
+}
+
+
+/* 
+ * shot_move moves a shot step rows up. every row it passes is swept for 
+ * saucers that were on its column while the shot was on that row: the row
+ * it has been on since it last moved, each row it would have been on for 
+ * SHOTTICKS ticks since, then the row it reaches now. so a saucer moving 
+ * over a shot between its moves is a hit, as is any it passes in a step
+ * on a hit the shot stops on that row, with the ticks it was there saved
+ * for mark_hits. draw should be locked, shared or exclusively, before 
+ * entering. the stripe of each row is locked while it is tested
+ * expects the address of the shot properties, due now, and the counts 
+ * hits_batch found for each row swept, or NULL to test every row
+ * returns 1 if the shot reached a saucer, -1 if it left the top of the 
+ * screen, 0 otherwise
+ */
+int shot_move(struct shotprop *info, int *maybe){
+	
+	int j, rows, hits;
+	int row = info->row;
+	long now = info->timer.due;
+	long from, to;
+	
+	trace_event("shot step", info->index);
+	
+	/* cover the old shot if no saucer has moved there */
+	lock_row(row);
+	if(span_count(row, info->col) == 0){
+		scr_addch(row, info->col, ' ');
+	}
+	unlock_row(row);
+	
+	rows = shot_rows(info);
+	for(j = 0; j <= rows; j++){
+		
+		/* the batch found no saucer that could be there */
+		if(maybe != NULL && maybe[j] == 0){
+			continue;
+		}
+		shot_window(info, j, rows, &from, &to);
+		
+		/* there were saucers at that position */
+		lock_row(row - j);
+		hits = sweep_hits(row - j, info->col, from, to, 0);
+		unlock_row(row - j);
+		if(hits > 0){
+			info->row = row - j;
+			info->from = from;
+			info->to = to;
+			info->moved = now;
+			trace_event("shot hit", info->index);
+			return 1;
+		}
+	}
+	
+	/* the new position (step) rows up */
+	info->row = row - rows;
+	info->moved = now;
+	
+	/* if no hit draw the new shot at the new position */
+	scr_addch(info->row, info->col, '^');
+	
+	/* reach the top of the screen without hitting anything */
+	if(info->row < 0){
+		return -1;
+	}
+	return 0;
+}
+
+
+/* 
+ * shots is the function used by all the shot threads
+ * prints shots on the screen
+ * in this program, recieves the address of the corresponding shot properties
+ * in this program, returns nothing
+ */
+void *shots(void *properties){
+
+	int moved;
+	struct shotprop *info = properties;
+	
+	while(1){
+		
+		/* sleep for SHOTTICKS ticks of the timer wheel */
+		timer_sleep(&game->shot_wheel, &info->timer, 
+		    info->timer.due + info->period);
+		
+		/* shot_move locks the stripe of each row it tests */
+		lock_draw_shared();
+		moved = shot_move(info, NULL);
+		if(moved > 0){
+				
+			/* find hits and update score, release draw */
+			find_hit(info->row, info->col, info->from, info->to);
+			
+			/* now we are done with this shot */
+			shot_finish(info);
+			pthread_exit(NULL);
+		}
+		unlock_draw_shared();
+		
+		/* if reach the top of the screen without hitting anything */
+		if(moved < 0){
+			
+			/* now we are finished with the thread */
+			shot_finish(info);
+			pthread_exit(NULL);
+		}
+	}
+}
+
+
+/* 
+ * shot_co is the coroutine engine's shot: the loop of shots, with each 
+ * wait for its timer a CO_SLEEP, run a move at a time by a scheduler thread
+ * expects the address of the shot properties, no return value
+ */
+void shot_co(void *properties){
+	
+	int moved;
+	struct shotprop *info = properties;
+	
+	CO_BEGIN(info);
+	while(1){
+		
+		/* give the scheduler back until SHOTTICKS ticks later */
+		CO_SLEEP(info, &game->shot_wheel, 
+		    info->timer.due + info->period);
+		
+		/* shot_move locks the stripe of each row it tests */
+		lock_draw_shared();
+		moved = shot_move(info, NULL);
+		if(moved > 0){
+			
+			/* find hits and update score, release draw */
+			find_hit(info->row, info->col, info->from, info->to);
+			shot_finish(info);
+			return;
+		}
+		unlock_draw_shared();
+		
+		/* reached the top of the screen without hitting anything */
+		if(moved < 0){
+			shot_finish(info);
+			return;
+		}
+	}
+	CO_END;
+}
+
+
+/*
+ * shot_finish gives a shot thread's slot back once it has scored, and wakes
+ * any find_end waiting on it. the slot's thread is joined when it is reused
+ * expects the address of the shot properties, no return value
+ */
+void shot_finish(struct shotprop *info){
+	
+	lock_draw();
+	info->alive = 0;
+	slot_free(&game->shot_slots, info->index);
+	unlock_draw();
+	
+	lock_timed(&end_timing);
+	pthread_cond_broadcast(&shot_done);
+	unlock_timed(&end_timing);
+}
+
+
+/*
+ * find_end waits for a shot to finish and checks if the program can exit
+ * if the shot finishes without hitting anything the program can exit
+ * otherwise more shots are available and the game can continue
+ * expects no args, uses the handle in last_shot, no return values
+ */
+void *find_end(){
+	
+	void *retval;
+	
+	/* keep track of the shot we are currently looking at */
+	uint64_t track = atomic_load(&game->last_shot);
+	
+	/* when there is no chance of hitting any other saucers */
+	/* the handle stops being valid once the shot's slot is freed */
+	lock_timed(&end_timing);
+	while(slot_valid(&game->shot_slots, track)){
+		wait_timed(&shot_done, &end_timing);
+	}
+	unlock_timed(&end_timing);
+	
+	/* must have 0 shots left and must be last shot ever (no updates!) */
+	if(game->shot_update == 0 && track == atomic_load(&game->last_shot)){
+		
+		/* if the last shot fired and misses: signal to exit game */
+		lock_timed(&end_timing);
+		pthread_cond_signal(&end_condition); 
+		unlock_timed(&end_timing);
+		pthread_exit(&retval);
+	}
+	
+	/* if the last shot does hit something go back to allowing new shots */
+	pthread_exit(&retval);
+}
+
+
+/* 
+ * tick_fire_shot hands a new shot record to the tick loop
+ * expects the current launch position, no return value
+ */
+void tick_fire_shot(int position){
+	
+	int i;
+	struct shotprop *info;
+	
+	/* the tick loop reads shot slots under the draw mutex */
+	lock_draw();
+	
+	/* if we still have shots left fire a new shot */
+	if(reserve_rocket()){
+		
+		/* take a free slot, or give the rocket back if there are */
+		/* none							   */
+		i = slot_alloc(&game->shot_slots);
+		if(i < 0){
+			atomic_fetch_add(&game->shot_update, 1);
+			unlock_draw();
+			return;
+		}
+	
+		/* set row & col for the shot (pos+1 b/c of the space) */
+		info = shot_at(i);
+		trace_event("shot fire", i);
+		info->index = i;
+		info->col = position + 1;
+		info->row = game->screen_rows - 3;
+		info->alive = 1;
+		info->timer.owner = info;
+		shot_schedule(info);
+		wheel_at(&game->shot_wheel, &info->timer, 
+		    info->moved + info->period);
+		
+		/* print the score now that a shot has been used */
+		draw_stats();
+	}
+	unlock_draw();
+}
+
+
+/* 
+ * shot_schedule sets a new shot to move one row every SHOTTICKS ticks, or 
+ * when a step of the tick engine is longer, enough rows at a time to keep 
+ * that pace, starting from the current tick
+ * expects the address of the shot properties, no return value
+ */
+void shot_schedule(struct shotprop *info){
+	
+	info->step = (tick_scale + SHOTTICKS - 1) / SHOTTICKS;
+	info->period = info->step * SHOTTICKS;
+	info->moved = wheel_now(&game->shot_wheel);
+	info->timer.due = info->moved;
+}
+
+
+/* 
+ * fire shot creates a new shot in a free shot slot
+ * expects the current launch position, no return value
+ */
+void fire_shot(int position){
+	
+	void *retval;
+	int i, joinable = 0;
+	struct shotprop *info;
+	
+	/* the tick loop has no shot threads or last shot monitor, so */
+	/* firing is only taking a slot, at the tick the key is handled */
+	if(game->tick_engine){
+		tick_fire_shot(position);
+		return;
+	}
+	
+	/* if we still have shots left create fire a new shot */
+	if(reserve_rocket()){
+		
+		/* take a free slot, or give the rocket back if there are */
+		/* none, and take back its thread id before it is written */
+		/* again						   */
+		lock_draw();
+		i = slot_alloc(&game->shot_slots);
+		if(i >= 0){
+			joinable = shot_at(i)->has_thread;
+			shot_at(i)->has_thread = 0;
+		}
+		unlock_draw();
+		if(i < 0){
+			atomic_fetch_add(&game->shot_update, 1);
+			return;
+		}
+		info = shot_at(i);
+		
+		/* the thread that last used this slot has freed it, wait for */
+		/* it to exit before reusing its record */
+		if(joinable){
+			pthread_join(info->thread, &retval);
+		}
+	
+		/* set row & col for the shot (pos+1 b/c of the space before|)*/
+		trace_event("shot fire", i);
+		info->index = i;
+		info->col = position + 1;
+		info->alive = 1;
+		info->timer.owner = info;
+		info->resume = 0;
+		sem_init(&info->timer.wake, 0, 0);
+		shot_schedule(info);
+		
+		/* initial row at bottom of screen, set here so a resize on */
+		/* this thread never sees the row of an old shot	    */
+		info->row = game->screen_rows - 3;
+		
+		/* this is now the last shot fired, before a coroutine's */
+		/* first CO_SLEEP so it is never a shot that has already */
+		/* finished						 */
+		atomic_store(&game->last_shot, 
+		    slot_handle(&game->shot_slots, i));
+		
+		/* a coroutine runs until its first CO_SLEEP */
+		if(coroutines){
+			shot_co(info);
+		}
+	
+		/* create a thread for the shot */
+		else if(pthread_create(&info->thread, NULL, shots, info)){
+			fprintf(stderr,"error creating shot thread\n");
+			endwin();
+			exit(-1);
+		}
+		else{
+			info->has_thread = 1;
+		}
+		
+		/* print the score now that a shot has been used */
+		stats();
+	}
+	
+	/* if the shot thread is at zero, see if it remains at zero */
+	if(game->shot_update == 0){
+		
+		/* create a thread to wait for the last shot to finish */
+		if(pthread_create(&end_t, NULL, find_end, NULL)){
+			fprintf(stderr,"error creating shot thread\n");
+			endwin();
+			exit(-1);
+		}
+	}
+}
+
+
+/* 
+ * deque_push adds a task to the bottom of a worker's deque, doubling the
+ * ring when it is full. expects the deque and task, no return value
+ */
+void deque_push(struct deque *q, struct task t){
+	
+	long i;
+	struct task *bigger;
+	
+	pthread_mutex_lock(&q->lock);
+	if(q->bottom - q->top == q->size){
+		
+		/* copy into a larger ring, keeping each task's position */
+		bigger = malloc(2 * q->size * sizeof(*bigger));
+		if(bigger == NULL){
+			fprintf(stderr, "malloc failed growing a task queue\n");
+			endwin();
+			exit(-1);
+		}
+		for(i = q->top; i < q->bottom; i++){
+			bigger[i & (2*q->size - 1)] = 
+			    q->tasks[i & (q->size - 1)];
+		}
+		free(q->tasks);
+		q->tasks = bigger;
+		q->size = 2 * q->size;
+	}
+	q->tasks[q->bottom & (q->size - 1)] = t;
+	q->bottom ++;
+	pthread_mutex_unlock(&q->lock);
+}
+
+
+/* 
+ * deque_take removes a task from a deque: the owner takes the newest from
+ * the bottom, while its data is still in cache, and another worker steals
+ * the oldest from the top. the tasks of a step are shares that do not 
+ * depend on each other, see tick_pooled, so the order does not change 
+ * the game
+ * expects the deque, where to store the task and 1 if stealing
+ * returns 1 if a task was taken, 0 if the deque was empty
+ */
+int deque_take(struct deque *q, struct task *t, int steal){
+	
+	int found = 0;
+	
+	pthread_mutex_lock(&q->lock);
+	if(q->bottom > q->top && steal){
+		*t = q->tasks[q->top & (q->size - 1)];
+		q->top ++;
+		found = 1;
+	}
+	else if(q->bottom > q->top){
+		q->bottom --;
+		*t = q->tasks[q->bottom & (q->size - 1)];
+		found = 1;
+	}
+	pthread_mutex_unlock(&q->lock);
+	return found;
+}
+
+
+/* 
+ * worker is the function used by all the pool threads
+ * runs tasks from its own deque, then steals from the others, and sleeps 
+ * when there is nothing queued anywhere
+ * expects its worker number cast to a pointer, no return value
+ */
+void *worker(void *self){
+	
+	int i, found;
+	int id = (intptr_t)self;
+	struct task t;
+	
+	while(1){
+		
+		/* look in our own deque first then try every other one */
+		found = 0;
+		for(i = 0; i < pool.n && !found; i++){
+			found = deque_take(&pool.queues[(id + i) % pool.n], 
+			    &t, i);
+		}
+		
+		/* nothing queued: sleep until pool_push signals */
+		if(!found){
+			pthread_mutex_lock(&pool.lock);
+			while(atomic_load(&pool.queued) == 0){
+				cond_wait(&pool.work, &pool.lock);
+			}
+			pthread_mutex_unlock(&pool.lock);
+			continue;
+		}
+		atomic_fetch_sub(&pool.queued, 1);
+		t.run(t.arg);
+		
+		/* let pool_wait know once the last outstanding task is done */
+		if(atomic_fetch_sub(&pool.pending, 1) == 1){
+			pthread_mutex_lock(&pool.lock);
+			pthread_cond_broadcast(&pool.done);
+			pthread_mutex_unlock(&pool.lock);
+		}
+	}
+}
+
+
+/* 
+ * pool_start creates the worker threads and their deques
+ * expects the number of workers, 0 for one per core, no return value
+ */
+void pool_start(int n){
+	
+	int i;
+	
+	if(n <= 0){
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(n <= 0){
+		n = 1;
+	}
+	
+	pool.n = n;
+	pool.queues = calloc(n, sizeof(*pool.queues));
+	pool.threads = calloc(n, sizeof(*pool.threads));
+	if(pool.queues == NULL || pool.threads == NULL){
+		fprintf(stderr, "calloc failed creating the worker pool\n");
+		exit(-1);
+	}
+	
+	for(i = 0; i < n; i++){
+		pthread_mutex_init(&pool.queues[i].lock, NULL);
+		pool.queues[i].size = 64;
+		pool.queues[i].tasks = malloc(64 * sizeof(struct task));
+		if(pool.queues[i].tasks == NULL){
+			fprintf(stderr, "malloc failed creating the worker "
+			    "pool\n");
+			exit(-1);
+		}
+	}
+	for(i = 0; i < n; i++){
+		if(pthread_create(&pool.threads[i], NULL, worker, 
+		    (void *)(intptr_t)i)){
+			fprintf(stderr, "error creating worker thread\n");
+			exit(-1);
+		}
+	}
+}
+
+
+/* 
+ * pool_push queues a task, spreading tasks over the workers' deques
+ * expects the function to run and its argument, no return value
+ */
+void pool_push(void (*run)(void *), void *arg){
+	
+	struct task t;
+	int id = atomic_fetch_add(&pool.next, 1) % pool.n;
+	
+	t.run = run;
+	t.arg = arg;
+	
+	atomic_fetch_add(&pool.pending, 1);
+	deque_push(&pool.queues[id], t);
+	atomic_fetch_add(&pool.queued, 1);
+	
+	/* wake a sleeping worker */
+	pthread_mutex_lock(&pool.lock);
+	pthread_cond_signal(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+
+/* 
+ * pool_wait blocks until every queued task has finished running
+ * expects no args & no return values
+ */
+void pool_wait(){
+	
+	pthread_mutex_lock(&pool.lock);
+	while(atomic_load(&pool.pending) > 0){
+		cond_wait(&pool.done, &pool.lock);
+	}
+	pthread_mutex_unlock(&pool.lock);
+}
+
+
+/*
+ * saucer_tick moves a saucer whose timer is due, replacing it once it 
+ * has been hit or has escaped. draw mutex must be locked before entering
+ * expects the address of the saucer properties
+ * returns 1 when too many saucers have escaped and 0 otherwise
+ */
+int saucer_tick(struct saucerprop *saucer){
+	
+	/* nothing moves once the game is over */
+	if(game->game_over){
+		return 0;
+	}
+	return saucer_settle(saucer, saucer_advance(saucer));
+}
+
+
+/*
+ * saucer_advance is the part of saucer_tick that only uses the saucer's 
+ * own row: it draws over a hit saucer and takes its interval out of the 
+ * collision index, or moves it a step. the draw mutex must be locked, or
+ * held shared with the stripe of the saucer's row
+ * expects the address of the saucer properties, returns what it did, 
+ * SAUCER_SKIPPED, SAUCER_CLEARED, SAUCER_ESCAPED or SAUCER_MOVED
+ */
+int saucer_advance(struct saucerprop *saucer){
+	
+	int i;
+	
+	if(!saucer->alive){
+		return SAUCER_SKIPPED;
+	}
+	if(saucer->kill == 1){
+		clear_saucer(saucer->len, saucer->col, saucer, saucer_blank);
+		return SAUCER_CLEARED;
+	}
+	for(i = 0; i < saucer->step; i++){
+		if(saucer_move(saucer)){
+			return SAUCER_ESCAPED;
+		}
+	}
+	return SAUCER_MOVED;
+}
+
+
+/*
+ * saucer_settle is the rest of saucer_tick, once saucer_advance has run: 
+ * a hit saucer is replaced straight away, an escaped one either ends the 
+ * game or is replaced, and one that moved is due again after (period) 
+ * ticks. draw mutex must be locked before entering
+ * expects the address of the saucer properties and what saucer_advance 
+ * did, returns 1 when too many saucers have escaped and 0 otherwise
+ */
+int saucer_settle(struct saucerprop *saucer, int done){
+	
+	if(done == SAUCER_SKIPPED){
+		return 0;
+	}
+	if(done == SAUCER_CLEARED){
+		saucer_replace(saucer);
+		return 0;
+	}
+	
+	game->updates ++;
+	if(done == SAUCER_ESCAPED){
+		if(saucer_escape()){
+			return 1;
+		}
+		saucer_replace(saucer);
+		return 0;
+	}
+	wheel_at(&game->saucer_wheel, &saucer->timer, 
+	    saucer->timer.due + saucer->period);
+	return 0;
+}
+
+
+/*
+ * saucer_replace frees a tick engine saucer's slot and starts a new saucer
+ * in a free slot, which is the same one unless another was freed since
+ * draw mutex must be locked before entering
+ * expects the address of the saucer properties, no return value
+ */
+void saucer_replace(struct saucerprop *saucer){
+	
+	saucer->alive = 0;
+	slot_free(&game->saucer_slots, saucer->index);
+	setup_saucer(saucer_alloc());
+}
+
+
+/*
+ * shot_tick moves a shot whose timer is due and scores any hit
+ * draw mutex must be locked before entering
+ * expects the address of the shot properties and the counts hits_batch 
+ * found for it, or NULL, no return value
+ */
+void shot_tick(struct shotprop *shot, int *maybe){
+	
+	int moved, hits;
+	
+	if(!shot->alive){
+		return;
+	}
+	
+	game->updates ++;
+	
+	moved = shot_move(shot, maybe);
+	if(moved > 0){
+		hits = mark_hits(shot->row, shot->col, shot->from, shot->to);
+		game->collisions += hits;
+		add_hits(hits);
+	}
+	if(moved != 0){
+		shot->alive = 0;
+		slot_free(&game->shot_slots, shot->index);
+		return;
+	}
+	
+	/* move again after (period) ticks */
+	wheel_at(&game->shot_wheel, &shot->timer, 
+	    shot->timer.due + shot->period);
+}
+
+
+/*
+ * due_grow makes room for n saucers due in a pooled step
+ * expects n, no return value
+ */
+void due_grow(int n){
+	
+	if(n <= game->duecap && game->rowstart != NULL){
+		return;
+	}
+	if(n > game->duecap){
+		game->duecap = 2 * n + 16;
+	}
+	game->due = realloc(game->due, game->duecap * sizeof(*game->due));
+	game->done = realloc(game->done, game->duecap * sizeof(int));
+	game->byrow = realloc(game->byrow, game->duecap * sizeof(int));
+	game->rowstart = realloc(game->rowstart, 
+	    (saucer_rows + 1) * sizeof(int));
+	if(game->due == NULL || game->done == NULL || game->byrow == NULL || 
+	    game->rowstart == NULL){
+		fprintf(stderr, "out of memory for due saucers\n");
+		endwin();
+		exit(-1);
+	}
+}
+
+
+/*
+ * saucer_work is a pool task moving the due saucers of a share of the 
+ * rows, with saucer_advance, each row's in the order they came due and 
+ * with its stripe locked. the thread running tick_pooled holds draw shared
+ * expects its share out of pool.n cast to a pointer, no return value
+ */
+void saucer_work(void *share){
+	
+	int row, j, i;
+	int k = (intptr_t)share;
+	
+	for(row = k * saucer_rows / pool.n; 
+	    row < (k + 1) * saucer_rows / pool.n; row++){
+		if(game->rowstart[row] == game->rowstart[row + 1]){
+			continue;
+		}
+		lock_row(row);
+		for(j = game->rowstart[row]; j < game->rowstart[row + 1]; j++){
+			i = game->byrow[j];
+			game->done[i] = saucer_advance(game->due[i]);
+		}
+		unlock_row(row);
+	}
+}
+
+
+/*
+ * shot_work is a pool task making the hit tests of a share of the shots in
+ * batch, as hits_batch does but one at a time with sweep_hits, each with
+ * its row's stripe locked. the thread running tick_pooled holds draw shared
+ * expects its share out of pool.n cast to a pointer, no return value
+ */
+void shot_work(void *share){
+	
+	int k = (intptr_t)share;
+	int t, row;
+	struct hitbatch *b = &game->batch;
+	int n = b->nshots;
+	
+	for(t = b->first[k * n / pool.n]; 
+	    t < b->first[(k + 1) * n / pool.n]; t++){
+		row = b->rows[t];
+		if(row < 0 || row >= saucer_rows){
+			continue;
+		}
+		lock_row(row);
+		b->counts[t] = sweep_hits(row, b->cols[t], b->from[t], 
+		    b->to[t], 0);
+		unlock_row(row);
+	}
+}
+
+
+/*
+ * tick_shares runs a task for each of the pool.n shares of some work with 
+ * draw held shared, on the pool, or on this thread when there is too 
+ * little work to be worth waking the workers for
+ * draw mutex must be locked before entering, and is locked on return
+ * expects the task and how much work there is, no return value
+ */
+void tick_shares(void (*run)(void *), int work){
+	
+	int k;
+	
+	if(work == 0){
+		return;
+	}
+	unlock_draw();
+	lock_draw_shared();
+	for(k = 0; k < pool.n; k++){
+		if(work < POOLMIN){
+			run((void *)(intptr_t)k);
+		}
+		else{
+			pool_push(run, (void *)(intptr_t)k);
+		}
+	}
+	if(work >= POOLMIN){
+		pool_wait();
+	}
+	unlock_draw_shared();
+	lock_draw();
+}
+
+
+/*
+ * tick_pooled does a step of tick_step on the worker pool. saucers on 
+ * different rows never meet, so each worker moves the saucers of its share
+ * of the rows, then tests a share of the shots against where the saucers 
+ * are now, all with draw held shared. what has to be done in order, 
+ * replacing saucers, scoring escapes, moving shots and marking hits, is 
+ * then done here with draw locked, in the order the records came due. the
+ * tests only tell shot_tick which rows can be skipped, as with hits_batch,
+ * so every step plays as it does without the pool. saucers due after one 
+ * that ends the game still move on the screen
+ * draw mutex must be locked before entering, and is locked on return
+ * expects no args & no return values
+ */
+void tick_pooled(){
+	
+	int i, row;
+	struct timer *t;
+	struct hitbatch *b = &game->batch;
+	
+	/* the saucers due, in order, then their numbers sorted by row */
+	game->ndue = 0;
+	for(t = wheel_window(&game->saucer_wheel); t != NULL; t = t->next){
+		due_grow(game->ndue + 1);
+		game->due[game->ndue++] = t->owner;
+	}
+	due_grow(game->ndue);
+	memset(game->rowstart, 0, (saucer_rows + 1) * sizeof(int));
+	for(i = 0; i < game->ndue; i++){
+		game->rowstart[game->due[i]->row + 1] ++;
+	}
+	for(row = 0; row < saucer_rows; row++){
+		game->rowstart[row + 1] += game->rowstart[row];
+	}
+	for(i = 0; i < game->ndue; i++){
+		game->byrow[game->rowstart[game->due[i]->row] ++] = i;
+	}
+	for(row = saucer_rows; row > 0; row--){
+		game->rowstart[row] = game->rowstart[row - 1];
+	}
+	game->rowstart[0] = 0;
+	
+	tick_shares(saucer_work, game->ndue);
+	
+	for(i = 0; i < game->ndue; i++){
+		if(!game->game_over && 
+		    saucer_settle(game->due[i], game->done[i])){
+			game->game_over = 1;
+		}
+	}
+	if(game->game_over){
+		return;
+	}
+	
+	/* the shots due, and the rows each sweeps, tested at once */
+	b->nshots = 0;
+	for(t = wheel_window(&game->shot_wheel); t != NULL; t = t->next){
+		batch_grow(1, 0);
+		b->shots[b->nshots++] = t->owner;
+	}
+	batch_tests();
+	
+	tick_shares(shot_work, b->ntests);
+	
+	for(i = 0; i < b->nshots && !game->game_over; i++){
+		shot_tick(b->shots[i], b->counts + b->first[i]);
+	}
+}
+
+
+/*
+ * tick_step advances the timer wheels by one step of tick_scale ticks and 
+ * moves every saucer and shot that came due, saucers first so the shots 
+ * probe where they are now. shots sweep the ticks they moved over, so they
+ * hit what they would have with a step of one tick
+ * this does the work of the saucer, shot, replacement and last shot threads
+ * either directly or with the worker pool, see tick_pooled
+ * draw mutex must be unlocked before entering
+ * expects no args, returns 1 when the game is over and 0 otherwise
+ */
+int tick_step(){
+	
+	int i, over;
+	struct timer *t, *next;
+	struct hitbatch *b = &game->batch;
+	long start = (timing || stress || instances) ? now_ns() : 0;
+	
+	/* the wheels and slots are only changed under draw, so hold it */
+	/* save next as moving a record may reschedule t		 */
+	lock_draw();
+	if(pool.n){
+		tick_pooled();
+	}
+	else{
+		for(t = wheel_window(&game->saucer_wheel); t != NULL; t = next){
+			next = t->next;
+			if(!game->game_over && saucer_tick(t->owner)){
+				game->game_over = 1;
+			}
+		}
+		
+		/* either test every rocket at once, then move them, or move */
+		/* and test them one by one */
+		if(batch_hits){
+			b->nshots = 0;
+			for(t = wheel_window(&game->shot_wheel); t != NULL; 
+			    t = t->next){
+				batch_grow(1, 0);
+				b->shots[b->nshots++] = t->owner;
+			}
+			hits_batch();
+			for(i = 0; i < b->nshots && !game->game_over; i++){
+				shot_tick(b->shots[i], 
+				    b->counts + b->first[i]);
+			}
+		}
+		else{
+			for(t = wheel_window(&game->shot_wheel); t != NULL; 
+			    t = next){
+				next = t->next;
+				if(!game->game_over){
+					shot_tick(t->owner, NULL);
+				}
+			}
+		}
+	}
+	
+	/* too many escaped, or the last shot missed: no rockets left and */
+	/* none in the air, that is every shot slot free */
+	over = game->game_over || (game->shot_update == 0 && 
+	    game->shot_slots.nfree == game->shot_slots.cap);
+	unlock_draw();
+	game->tick_count += tick_scale;
+	
+	/* only the thread running tick_step records ticks */
+	if(timing || stress || instances){
+		hist_record(&game->tick_hist, now_ns() - start);
+	}
+	return over;
+}
+
+
+/*
+ * tick_input handles the keys due before the next tick, so the player's 
+ * actions happen at the same ticks when a recording is replayed
+ * expects no args, returns 1 if the player quit and 0 otherwise
+ */
+int tick_input(){
+	
+	int c;
+	
+	while((c = poll_key()) != ERR){
+		if(handle_key(c)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * tick_loop is run by a single thread when the tick engine is selected
+ * it starts the game, then handles keys and advances all saucers and shots
+ * every step of tick_scale ticks of TICK microseconds, sleeping until an 
+ * absolute deadline so the pace does not drift
+ * expects no args & no return values
+ */
+void *tick_loop(){
+	
+	int i, n;
+	int keys[AUTOKEYS];
+	struct timespec next;
+	
+	/* main cancels and joins this thread at the end of the game, so */
+	/* it only stops between steps, never holding draw or the pool   */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	
+	/* set a seed so saucers will be different each game */
+	seed_game(getpid());
+	game_start();
+	
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while(1){
+		
+		/* wait for the start of the next step */
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		sleep_until(&next, TICK * tick_scale);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		
+		/* the autopilot's keys go through the key queue, so they are */
+		/* handled and recorded as the player's would be	      */
+		if(autopilot){
+			n = autopilot_keys(game->tick_count, keys);
+			for(i = 0; i < n; i++){
+				key_push(keys[i], AUTOKEYS);
+			}
+		}
+		
+		/* 'Q' has already signalled main */
+		if(tick_input()){
+			return NULL;
+		}
+		if(tick_step()){
+			
+			/* send signal to the main function */
+			lock_timed(&end_timing);
+			pthread_cond_signal(&end_condition);
+			unlock_timed(&end_timing);
+			return NULL;
+		}
+	}
+}
+
+
+/*
+ * game_start draws the status line and launch site and starts the initial 
+ * saucers - they run/exit in saucers or tick_loop
+ * expects no args & no return values
+ */
+void game_start(){
+	
+	int i;
+	
+	game->launch_position = (game->screen_cols-1)/2;
+	game->nsaucers = start_saucers;
+	
+	/* print message with info about the game @ the bottom of the page */
+	stats();
+	
+	/* draw original launch site in the middle of the screen */
+	launch_site(0, game->launch_position);
+	
+	/* start each initial saucer */
+	for(i=0; i<start_saucers; i++){
+		start_saucer();
+	}
+}
+
+
+/*
+ * handle_key responds to one key press from the player
+ * expects the key, returns 1 if the player quit and 0 otherwise
+ */
+int handle_key(int c){
+	
+	/* the terminal has been resized */
+	if(IS_SIZE_KEY(c)){
+		lock_draw();
+		screen_resize(SIZE_ROWS(c), SIZE_COLS(c));
+		unlock_draw();
+		return 0;
+	}
+	
+	/* Add more saucers at random */
+	/* The more shots taken, the more saucers added */
+	if(rng_below(&game->roll, RANDSAUCERS) == 0 && 
+	    game->nsaucers < max_saucers){
+		game->nsaucers = rand_saucers(game->nsaucers);
+	}
+	
+	/* quit program */
+	if(c == 'Q'){
+		
+		/* signal the main function */
+		lock_timed(&end_timing);
+		pthread_cond_signal(&end_condition);
+		unlock_timed(&end_timing);
+		return 1;
+	}
+	
+	/* pausing the game: an intentional use of deadlock!! */
+	else if(c == 'p'){
+		
+		/* stop anything from being drawn on the screen */
+		lock_draw();
+		
+		/* print message letting user know game is paused */
+		scr_printw(10, 10, "PAUSED");
+		scr_printw(11, 10, "(press 'p' to resume)");
+		
+		/* wait for user to press 'p' to resume game */
+		while(1){
+			c = read_key();
+			if(IS_SIZE_KEY(c)){
+				screen_resize(SIZE_ROWS(c), SIZE_COLS(c));
+				scr_printw(10, 10, "PAUSED");
+				scr_printw(11, 10, "(press 'p' to resume)");
+			}
+			else if (c == 'p'){
+				
+				/* cover pause message and return */
+				scr_printw(10,10,"      ");
+				scr_printw(11,10,"                     ");
+				break;
+			}
+		}
+		
+		/* stop deadlock */
+		unlock_draw();
+	}
+	/* toggle turning colour on or off */
+	else if(c == 'c'){
+		
+		/* set use_colour to the opposite of what it is now */
+		lock_draw();
+		if (use_colour){
+			use_colour = 0;
+		}
+		else{
+			use_colour = 1;
+		}
+		unlock_draw();
+	}
+	
+	/* move launch site to the left */
+	else if(c == ','){
+		game->launch_position = launch_site(-1, game->launch_position);
+	}
+	
+	/* move launch site to the right */
+	else if(c == '.'){
+		game->launch_position = launch_site(1, game->launch_position);
+	}
+	
+	/* fire one shot */
+	else if(c == ' '){
+		
+		/* if we are not out of shots yet fire the next one */
+		if(game->shot_update > 0){
+			
+			fire_shot(game->launch_position);
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * process_input deals with the user input from the terminal
+ * in this program process_input is run as a single thread
+ * expects no arguments, no return value
+ */
+void *process_input(){
+	
+	/* set a seed so saucers will be different each game */
+	seed_game(getpid());
+	game_start();
+	
+	/* process user input until the player quits */
+	while(!handle_key(read_key())){
+	}
+	return NULL;
+}
+
+
+/*
+ * game_reset clears the collision index, records and score so a new game
+ * can be started. only used headless, where nothing else is running
+ * expects no args & no return values
+ */
+void game_reset(){
+	
+	lock_draw();
+	spans_clear();
+	memset(game->screen_buf, ' ', game->screen_rows * game->screen_cols);
+	slots_clear(&game->saucer_slots);
+	slots_clear(&game->shot_slots);
+	wheel_init(&game->saucer_wheel);
+	wheel_init(&game->shot_wheel);
+	game->escape_update = 0;
+	game->shot_update = start_rockets;
+	game->score_update = 0;
+	game->game_over = 0;
+	unlock_draw();
+	
+	game_start();
+}
+
+
+/*
+ * bench_player is the player used headless: every SHOTTICKS ticks it fires,
+ * otherwise it moves the launch site, turning round at the edges. a step 
+ * of several ticks gets the keys of each of its ticks
+ * expects the tick number the step starts at, no return value
+ */
+void bench_player(long tick){
+	
+	int old;
+	long t;
+	
+	for(t = tick; t < tick + tick_scale; t++){
+		if(t % SHOTTICKS == 0){
+			handle_key(' ');
+			continue;
+		}
+		old = game->launch_position;
+		handle_key(game->player_direction);
+		if(game->launch_position == old){
+			game->player_direction = 
+			    (game->player_direction == '.') ? ',' : '.';
+		}
+	}
+}
+
+
+/*
+ * autopilot_keys picks the keys the autopilot presses in a tick. for each
+ * saucer in the collision index it works out where a rocket could meet it:
+ * where the saucer will be once the launch site has moved under it and a 
+ * rocket has climbed to its row, from its interval and speed. it moves 
+ * toward the nearest such place and fires once there, once at each saucer.
+ * then it fires blind as many times as aggression says
+ * draw must be unlocked before entering
+ * expects the tick and where to store up to AUTOKEYS keys
+ * returns the number of keys
+ */
+int autopilot_keys(long tick, int *keys){
+	
+	int row, i, mid, d, blind;
+	int n = 0, want = -1, best = INT_MAX;
+	int pos = game->launch_position;
+	int half = (strlen(saucer_shape) - 1) / 2;
+	long climb;
+	uint64_t handle, target = 0;
+	struct rowspans *r;
+	struct saucerprop *info;
+	
+	lock_draw_shared();
+	for(row = 0; row < saucer_rows; row++){
+		lock_row(row);
+		r = &game->spans[row];
+		climb = (long)(game->screen_rows - 3 - row) * SHOTTICKS;
+		for(i = 0; i < r->n; i++){
+			info = saucer_at(r->id[i]);
+			handle = slot_handle(&game->saucer_slots, info->index);
+			if(info->kill || handle == game->auto_target){
+				continue;
+			}
+			
+			/* the middle of the saucer when the rocket gets */
+			/* there, then again allowing for moving the	 */
+			/* launch site there				 */
+			mid = r->first[i] + half + climb / info->delay;
+			d = abs(mid - 1 - pos);
+			mid = r->first[i] + half + (climb + d) / info->delay;
+			d = abs(mid - 1 - pos);
+			
+			/* the launch site can only be where launch_site */
+			/* allows					 */
+			if(mid - 1 < 0 || mid - 1 >= game->screen_cols - 3){
+				continue;
+			}
+			if(d < best){
+				best = d;
+				want = mid - 1;
+				target = handle;
+			}
+		}
+		unlock_row(row);
+	}
+	unlock_draw_shared();
+	
+	/* a step toward the saucer, firing if that puts it underneath */
+	if(want >= 0 && want != pos){
+		keys[n++] = want > pos ? '.' : ',';
+		pos += want > pos ? 1 : -1;
+	}
+	if(want >= 0 && want == pos){
+		keys[n++] = ' ';
+		game->auto_target = target;
+	}
+	
+	/* every SHOTTICKS ticks at aggression 1, aggression-1 a tick above */
+	blind = (aggression == 1) ? (tick % SHOTTICKS == 0) : aggression - 1;
+	while(blind-- > 0 && n < AUTOKEYS){
+		keys[n++] = ' ';
+	}
+	return n;
+}
+
+
+/*
+ * autopilot_play is the headless player with -A: the autopilot's keys are
+ * handled straight away, for each tick of a step
+ * expects the tick number the step starts at, no return value
+ */
+void autopilot_play(long tick){
+	
+	int i, n;
+	int keys[AUTOKEYS];
+	long t;
+	
+	for(t = tick; t < tick + tick_scale; t++){
+		n = autopilot_keys(t, keys);
+		for(i = 0; i < n; i++){
+			handle_key(keys[i]);
+		}
+	}
+}
+
+
+/*
+ * autopilot_thread is run by a single thread with the threaded engine and
+ * -A. every TICK microseconds it queues the autopilot's keys for 
+ * process_input, as the render thread does the player's
+ * expects no args & no return values
+ */
+void *autopilot_thread(){
+	
+	int i, n;
+	int keys[AUTOKEYS];
+	long tick = 0;
+	struct timespec next;
+	
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while(1){
+		sleep_until(&next, TICK);
+		n = autopilot_keys(tick++, keys);
+		for(i = 0; i < n; i++){
+			key_push(keys[i], AUTOKEYS);
+		}
+	}
+}
+
+
+/*
+ * headless_player presses the keys of a headless game for a step: the 
+ * autopilot's with -A, otherwise the stress or bench player's
+ * expects the tick number the step starts at, no return value
+ */
+void headless_player(long tick){
+	
+	if(autopilot){
+		autopilot_play(tick);
+	}
+	else if(stress){
+		stress_player(tick);
+	}
+	else{
+		bench_player(tick);
+	}
+}
+
+
+/*
+ * stress_player is the player of a stress run: every tick it fires 
+ * stress_shots rockets from launch sites spread across the screen, which 
+ * move one column a tick so every column is fired from
+ * expects the tick number the step starts at, no return value
+ */
+void stress_player(long tick){
+	
+	int i;
+	int width = game->screen_cols - 3;
+	long t;
+	
+	for(t = tick; t < tick + tick_scale; t++){
+		for(i = 0; i < stress_shots; i++){
+			fire_shot((int)((t + (long)i * width / stress_shots) 
+			    % width));
+		}
+	}
+}
+
+
+/*
+ * stress_report prints what a stress run found: its size, how long steps 
+ * took and the most memory the process used
+ * expects no args & no return values
+ */
+void stress_report(){
+	
+	struct rusage usage;
+	struct histogram *h = &game->tick_hist;
+	
+	getrusage(RUSAGE_SELF, &usage);
+	printf("stress: %d saucers on %d rows, %d rockets a tick\n", 
+	    start_saucers, saucer_rows, stress_shots);
+	printf("step time in us: mean %.2f, p50 %.2f, p99 %.2f, max %.2f\n",
+	    h->count ? h->total / 1000.0 / h->count : 0.0,
+	    hist_value(h, 0.5) / 1000.0, hist_value(h, 0.99) / 1000.0, 
+	    h->max / 1000.0);
+	printf("peak memory: %ld KiB, saucer slots: %d, shot slots: %d\n",
+	    usage.ru_maxrss, game->saucer_slots.cap, game->shot_slots.cap);
+}
+
+
+/*
+ * headless_run runs the tick engine as fast as it can with no terminal or
+ * sleeping, drawing into the in-memory screen. a game that ends is reset so
+ * the run always lasts the requested number of ticks. when replaying, the
+ * keys come from the recording and the run ends with the game instead
+ * prints entities updated, collisions resolved and ticks per second
+ * expects the number of ticks to run, no return value
+ */
+void headless_run(long ticks){
+	
+	long t;
+	int games = 1;
+	double secs;
+	struct timespec start, end;
+	
+	/* the same seed every run so the numbers can be compared */
+	seed_game(1);
+	game_start();
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(t = 0; t < ticks; t += tick_scale){
+		if(rec.mode == REC_REPLAY){
+			if(tick_input() || tick_step()){
+				t += tick_scale;
+				break;
+			}
+			continue;
+		}
+		headless_player(t);
+		if(tick_step()){
+			game_reset();
+			games ++;
+		}
+		if(timing){
+			stats_poll();
+		}
+	}
+	ticks = t;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	
+	secs = (end.tv_sec - start.tv_sec) + 
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+	if(secs <= 0){
+		secs = 1e-9;
+	}
+	printf("screen: %dx%d, workers: %d, games: %d, seconds: %.3f\n",
+	    game->screen_rows, game->screen_cols, pool.n, games, secs);
+	printf("ticks: %ld (%.0f/s)\n", ticks, ticks / secs);
+	printf("steps of %d ticks: %ld (%.0f/s)\n", tick_scale, 
+	    ticks / tick_scale, ticks / tick_scale / secs);
+	printf("entity updates: %ld (%.0f/s)\n", game->updates, 
+	    game->updates / secs);
+	printf("collisions: %ld (%.0f/s)\n", game->collisions, 
+	    game->collisions / secs);
+	if(stress){
+		stress_report();
+	}
+	if(rec.mode == REC_REPLAY){
+		printf("final score: %d, rockets left: %d, escaped "
+		    "saucers: %d\n",
+		    (int)game->score_update, (int)game->shot_update, 
+		    (int)game->escape_update);
+	}
+	if(timing){
+		stats_write();
+	}
+}
+
+
+/*
+ * game_init sets up the calling thread's game, which must be zeroed, to 
+ * be played headless on a screen of a given size, as main does main_game
+ * expects the screen rows and cols, no return value
+ */
+void game_init(int rows, int cols){
+	
+	pthread_rwlockattr_t attr;
+	
+	game->saucer_slots.size = sizeof(struct saucerprop);
+	game->shot_slots.size = sizeof(struct shotprop);
+	game->tick_engine = 1;
+	game->headless = 1;
+	slots_init(&game->saucer_slots, MAXSAUCERS);
+	slots_init(&game->shot_slots, MAXSHOTS);
+	wheel_init(&game->saucer_wheel);
+	wheel_init(&game->shot_wheel);
+	spans_init();
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr, 
+	    PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&game->draw, &attr);
+	pthread_rwlockattr_destroy(&attr);
+	game->draw_timing.name = "draw";
+	game->draw_timing.rwlock = &game->draw;
+	game->shot_update = start_rockets;
+	game->player_direction = '.';
+	
+	game->screen_rows = rows;
+	game->screen_cols = cols;
+	game->screen_buf = malloc(rows * cols);
+	if(game->screen_buf == NULL){
+		fprintf(stderr, "malloc failed, maybe we ran out of memory\n");
+		exit(-1);
+	}
+	memset(game->screen_buf, ' ', rows * cols);
+}
+
+
+/*
+ * runner_thread is the function used by all the runner threads. it pins 
+ * itself to a core, then plays its shard of the games, every game t where
+ * t % runner_threads is its number, a step of each in turn, with the 
+ * headless player. a game that ends is started again
+ * expects its thread number cast to a pointer, no return value
+ */
+void *runner_thread(void *self){
+	
+	int i;
+	int id = (intptr_t)self;
+	long t;
+	cpu_set_t cpus;
+	
+	CPU_ZERO(&cpus);
+	CPU_SET(id % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	
+	for(t = 0; t < runner_ticks; t += tick_scale){
+		for(i = id; i < instances; i += runner_threads){
+			game = &instance[i];
+			headless_player(t);
+			if(tick_step()){
+				game_reset();
+				game->games ++;
+			}
+			game->ticks += tick_scale;
+		}
+	}
+	return NULL;
+}
+
+
+/*
+ * runner_run plays a number of headless games at once, sharded over a 
+ * thread per core or a given number of threads, and reports how many 
+ * games they finished a second and how long their steps took
+ * expects the number of games and threads, 0 for one per core, the screen
+ * rows and cols and the ticks to play each game for, no return value
+ */
+void runner_run(int n, int threads, int rows, int cols, long ticks){
+	
+	int i, k;
+	long games = 0, steps = 0, moves = 0, hits = 0;
+	double secs, best = -1, worst = 0, p99;
+	struct timespec start, end;
+	struct histogram *all = calloc(1, sizeof(*all));
+	pthread_t *runners;
+	
+	if(threads <= 0){
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(threads > n){
+		threads = n;
+	}
+	runner_threads = threads;
+	instance = calloc(n, sizeof(*instance));
+	runners = calloc(threads, sizeof(*runners));
+	if(all == NULL || instance == NULL || runners == NULL){
+		fprintf(stderr, "calloc failed, maybe we ran out of memory\n");
+		exit(-1);
+	}
+	
+	/* game i plays stream i of the headless run's seed, whatever */
+	/* thread it is on, the first the same as a headless run	  */
+	for(i = 0; i < n; i++){
+		game = &instance[i];
+		game_init(rows, cols);
+		game_seed(1, i);
+		game_start();
+	}
+	game = &main_game;
+	runner_ticks = ticks;
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i = 0; i < threads; i++){
+		if(pthread_create(&runners[i], NULL, runner_thread, 
+		    (void *)(intptr_t)i)){
+			fprintf(stderr, "error creating runner thread\n");
+			exit(-1);
+		}
+	}
+	for(i = 0; i < threads; i++){
+		pthread_join(runners[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = (end.tv_sec - start.tv_sec) + 
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+	if(secs <= 0){
+		secs = 1e-9;
+	}
+	
+	/* add up the games, and the steps of every game as one histogram */
+	for(i = 0; i < n; i++){
+		games += instance[i].games;
+		steps += instance[i].ticks / tick_scale;
+		moves += instance[i].updates;
+		hits += instance[i].collisions;
+		all->count += instance[i].tick_hist.count;
+		all->total += instance[i].tick_hist.total;
+		if(instance[i].tick_hist.max > all->max){
+			all->max = instance[i].tick_hist.max;
+		}
+		for(k = 0; k < HISTBUCKETS; k++){
+			all->buckets[k] += instance[i].tick_hist.buckets[k];
+		}
+		p99 = hist_value(&instance[i].tick_hist, 0.99) / 1000.0;
+		if(best < 0 || p99 < best){
+			best = p99;
+		}
+		if(p99 > worst){
+			worst = p99;
+		}
+	}
+	printf("runner: %d games on %d threads, screen: %dx%d, seconds: %.3f\n",
+	    n, threads, rows, cols, secs);
+	printf("steps of %d ticks: %ld (%.0f/s)\n", tick_scale, steps, 
+	    steps / secs);
+	printf("games finished: %ld (%.1f/s)\n", games, games / secs);
+	printf("entity updates: %ld (%.0f/s)\n", moves, moves / secs);
+	printf("collisions: %ld (%.0f/s)\n", hits, hits / secs);
+	printf("step time in us: mean %.2f, p50 %.2f, p99 %.2f, max %.2f\n",
+	    all->count ? all->total / 1000.0 / all->count : 0.0,
+	    hist_value(all, 0.5) / 1000.0, hist_value(all, 0.99) / 1000.0, 
+	    all->max / 1000.0);
+	printf("p99 step time of a game in us: best %.2f, worst %.2f\n", 
+	    best, worst);
+}
+
+
+/*
+ * env_create makes a batch of headless games for env_reset and env_step. 
+ * they use the tick engine whatever other games in the process use. each
+ * game is only ever played by one thread at a time, but separate batches
+ * can be played on separate threads
+ * expects the number of games and the rows and cols of their screens
+ * returns the batch
+ */
+struct env *env_create(int n, int rows, int cols){
+	
+	int i;
+	struct game *old = game;
+	struct env *e = calloc(1, sizeof(*e));
+	
+	if(e != NULL){
+		e->games = calloc(n, sizeof(*e->games));
+		e->score = calloc(n, sizeof(int));
+	}
+	if(e == NULL || e->games == NULL || e->score == NULL){
+		fprintf(stderr, "calloc failed, maybe we ran out of memory\n");
+		exit(-1);
+	}
+	e->n = n;
+	e->obs_size = rows * cols;
+	for(i = 0; i < n; i++){
+		game = &e->games[i];
+		game_init(rows, cols);
+	}
+	game = old;
+	return e;
+}
+
+
+/*
+ * env_reset starts a new game in each game of a batch, game i with 
+ * stream i of a seed
+ * expects the batch and the seed, no return value
+ */
+void env_reset(struct env *e, unsigned seed){
+	
+	int i;
+	struct game *old = game;
+	
+	for(i = 0; i < e->n; i++){
+		game = &e->games[i];
+		game_seed(seed, i);
+		game_reset();
+		e->score[i] = game->score_update;
+	}
+	game = old;
+}
+
+
+/*
+ * env_step plays one step of tick_scale ticks of the first n games of a 
+ * batch, each taking its action first. it writes each game's screen after
+ * the step to obs, obs_size bytes a game, the points it scored to rewards,
+ * and to dones 1 if it ended: too many saucers escaped, or no rockets are
+ * left and none in the air. a game that ended starts again, and its 
+ * observation is the start of the new game. nothing is allocated
+ * expects the batch, n actions (ENV_NONE etc.), the number of games and 
+ * where to write n observations, rewards and dones, no return value
+ */
+void env_step(struct env *e, const int *actions, int n, char *obs, 
+    int *rewards, char *dones){
+	
+	static const int keys[] = {0, ',', '.', ' '};
+	int i;
+	struct game *old = game;
+	
+	for(i = 0; i < n && i < e->n; i++){
+		game = &e->games[i];
+		if(actions[i] > ENV_NONE && actions[i] <= ENV_FIRE){
+			handle_key(keys[actions[i]]);
+		}
+		dones[i] = tick_step();
+		rewards[i] = game->score_update - e->score[i];
+		if(dones[i]){
+			game_reset();
+		}
+		e->score[i] = game->score_update;
+		memcpy(obs + (size_t)i * e->obs_size, game->screen_buf, 
+		    e->obs_size);
+	}
+	game = old;
+}
+
+
+/*
+ * env_thread is the function used by all the env_bench threads: it makes 
+ * its share of the games and plays them through env_step with random 
+ * actions, firing a quarter of the time. the actions are made up before
+ * starting, so only the games are timed
+ * expects its thread number cast to a pointer, returns an array of the 
+ * total reward and the number of games ended
+ */
+void *env_thread(void *self){
+	
+	int i;
+	int id = (intptr_t)self;
+	int n = env_games / env_threads + (id < env_games % env_threads);
+	long t, *totals = calloc(2, sizeof(long));
+	struct env *e = env_create(n, game->screen_rows, game->screen_cols);
+	int *actions = malloc(1024 * n * sizeof(int));
+	int *rewards = malloc(n * sizeof(int));
+	char *dones = malloc(n);
+	char *obs = malloc((size_t)n * e->obs_size);
+	unsigned r = id + 1;
+	
+	if(totals == NULL || actions == NULL || rewards == NULL || 
+	    dones == NULL || obs == NULL){
+		fprintf(stderr, "malloc failed, maybe we ran out of memory\n");
+		exit(-1);
+	}
+	for(i = 0; i < 1024 * n; i++){
+		r = r * 1103515245 + 12345;
+		actions[i] = (r >> 16) % 4;
+	}
+	env_reset(e, id + 1);
+	for(t = 0; t < runner_ticks; t += tick_scale){
+		env_step(e, actions + (t / tick_scale % 1024) * n, n, obs, 
+		    rewards, dones);
+		for(i = 0; i < n; i++){
+			totals[0] += rewards[i];
+			totals[1] += dones[i];
+		}
+	}
+	return totals;
+}
+
+
+/*
+ * env_bench plays a number of games through env_step on some threads and 
+ * reports how many game steps a second they played
+ * expects the number of games and threads, 0 for one, the screen rows and
+ * cols and the ticks to play each game for, no return value
+ */
+void env_bench(int n, int threads, int rows, int cols, long ticks){
+	
+	int i;
+	long reward = 0, ended = 0, *totals;
+	double secs;
+	struct timespec start, end;
+	pthread_t *players;
+	
+	if(threads <= 0){
+		threads = 1;
+	}
+	if(threads > n){
+		threads = n;
+	}
+	env_threads = threads;
+	runner_ticks = ticks;
+	main_game.screen_rows = rows;
+	main_game.screen_cols = cols;
+	players = calloc(threads, sizeof(*players));
+	if(players == NULL){
+		fprintf(stderr, "calloc failed, maybe we ran out of memory\n");
+		exit(-1);
+	}
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i = 0; i < threads; i++){
+		if(pthread_create(&players[i], NULL, env_thread, 
+		    (void *)(intptr_t)i)){
+			fprintf(stderr, "error creating env thread\n");
+			exit(-1);
+		}
+	}
+	for(i = 0; i < threads; i++){
+		pthread_join(players[i], (void **)&totals);
+		reward += totals[0];
+		ended += totals[1];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = (end.tv_sec - start.tv_sec) + 
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+	if(secs <= 0){
+		secs = 1e-9;
+	}
+	printf("env: %d games on %d threads, screen: %dx%d, seconds: %.3f\n",
+	    n, threads, rows, cols, secs);
+	printf("game steps of %d ticks: %ld (%.0f/s)\n", tick_scale, 
+	    n * (ticks / tick_scale), n * (ticks / tick_scale) / secs);
+	printf("reward: %ld, games ended: %ld\n", reward, ended);
+}
+
+
+/*
+ * micro_setup starts a case of micro_bench: an in-memory screen of a size 
+ * with a number of saucers spread over its rows and columns, each already 
+ * in the collision index, and as many shots in flight. saucers are born 
+ * long enough ago that a hit test finds them where they are now
+ * expects the screen rows and cols and the number of each, no return value
+ */
+void micro_setup(int rows, int cols, int n){
+	
+	int i;
+	struct saucerprop *saucer;
+	struct shotprop *shot;
+	
+	lock_draw();
+	spans_clear();
+	slots_clear(&game->saucer_slots);
+	slots_clear(&game->shot_slots);
+	wheel_init(&game->saucer_wheel);
+	wheel_init(&game->shot_wheel);
+	saucer_rows = rows - 3;
+	game->screen_rows = rows;
+	game->screen_cols = cols;
+	game->screen_buf = realloc(game->screen_buf, rows * cols);
+	micro_cols = realloc(micro_cols, n * sizeof(int));
+	if(game->screen_buf == NULL || micro_cols == NULL){
+		fprintf(stderr, "malloc failed, maybe we ran out of memory\n");
+		exit(-1);
+	}
+	memset(game->screen_buf, ' ', rows * cols);
+	micro_count = n;
+	
+	game_seed(1, 0);
+	for(i = 0; i < n; i++){
+		setup_saucer(saucer_alloc());
+		saucer = saucer_at(i);
+		saucer->col = rng_below(&game->roll, 
+		    cols - 2 * strlen(saucer_shape));
+		saucer->born = -(1L << 40);
+		saucer_move(saucer);
+		
+		/* somewhere on the saucer, for find_hit */
+		micro_cols[i] = saucer->col + 
+		    rng_below(&game->roll, strlen(saucer_shape) - 1);
+		
+		shot = shot_at(slot_alloc(&game->shot_slots));
+		shot->col = 1 + rng_below(&game->roll, cols - 2);
+		shot->row = rng_below(&game->roll, rows - 2);
+		shot->alive = 1;
+		shot->step = 1;
+		shot->period = SHOTTICKS;
+		shot->moved = 0;
+		shot->timer.due = 0;
+	}
+	unlock_draw();
+}
+
+
+/*
+ * micro_saucer, micro_shot, micro_find, micro_hit and micro_stats are the 
+ * cases of micro_bench, each doing the work of one saucer or shot. all 
+ * but micro_find do it as the threaded engine does, including the 
+ * locking. micro_find does it as the tick engine does, marking hits with 
+ * draw held exclusively as tick_step holds it, not shared with the row's 
+ * stripe as the threaded engine's find_hit does, since micro_bench runs 
+ * with the tick engine's add_hits, which draws the stats. micro_unkill 
+ * and micro_unhit put back what a pass of micro_find and micro_hit changed
+ * expects the number of the saucer or shot, but micro_stats none, no 
+ * return value
+ */
+void micro_saucer(int i){
+	
+	struct saucerprop *info = saucer_at(i);
+	int escaped;
+	
+	/* the loop of saucers */
+	lock_draw_shared();
+	lock_row(info->row);
+	escaped = saucer_move(info);
+	unlock_row(info->row);
+	unlock_draw_shared();
+	
+	/* fly across again */
+	if(escaped){
+		info->col = 0;
+		info->len = strlen(saucer_shape);
+	}
+}
+
+void micro_shot(int i){
+	
+	struct shotprop *info = shot_at(i);
+	
+	/* the loop of shots, up to finding a hit */
+	lock_draw_shared();
+	if(shot_move(info, NULL)){
+		info->row = game->screen_rows - 3;
+	}
+	unlock_draw_shared();
+}
+
+void micro_find(int i){
+	
+	int hits;
+	
+	lock_draw();
+	hits = mark_hits(saucer_at(i)->row, micro_cols[i], 0, 0);
+	game->collisions += hits;
+	add_hits(hits);
+	unlock_draw();
+}
+
+void micro_unkill(int i){
+	
+	saucer_at(i)->kill = 0;
+}
+
+void micro_hit(int i){
+	
+	struct saucerprop *info = saucer_at(i);
+	
+	saucer_hit(info->len, info->col, info, saucer_blank);
+}
+
+void micro_unhit(int i){
+	
+	struct saucerprop *info = saucer_at(i);
+	
+	/* back in the collision index one column on */
+	info->col --;
+	saucer_move(info);
+}
+
+void micro_stats(){
+	
+	stats();
+}
+
+
+/*
+ * micro_case times one case of micro_bench: passes over every saucer or 
+ * shot until MICROTIME has gone, with anything to put back done between
+ * passes and not timed. writes the result as a JSON object
+ * expects the JSON file, 1 if it is not the first result, the case name,
+ * screen size, the case and the function putting back after it or NULL
+ * no return value
+ */
+void micro_case(FILE *out, int comma, char *name, int rows, int cols, 
+    void (*run)(), void (*undo)()){
+	
+	int i;
+	long start, ns = 0, ops = 0;
+	
+	while(ns < MICROTIME){
+		start = now_ns();
+		for(i = 0; i < micro_count; i++){
+			run(i);
+		}
+		ns += now_ns() - start;
+		ops += micro_count;
+		for(i = 0; undo != NULL && i < micro_count; i++){
+			undo(i);
+		}
+	}
+	fprintf(out, "%s\n    {\"name\": \"%s\", \"rows\": %d, \"cols\": %d, "
+	    "\"entities\": %d, \"ops\": %ld, \"ns_per_op\": %.2f}", 
+	    comma ? "," : "", name, rows, cols, micro_count, ops, 
+	    (double)ns / ops);
+	if(out != stdout){
+		printf("%-12s %4dx%-4d %6d %12.2f ns\n", name, rows, cols, 
+		    micro_count, (double)ns / ops);
+	}
+}
+
+
+/*
+ * micro_bench times the work done for each saucer and shot every tick, on
+ * each of MICROSIZES with each of MICROCOUNTS saucers and shots, and 
+ * writes the results as JSON so builds can be compared
+ * expects the file to write, or - for the standard output, no return value
+ */
+void micro_bench(char *path){
+	
+	int s, n, comma = 0;
+	int sizes[][2] = MICROSIZES;
+	int counts[] = MICROCOUNTS;
+	FILE *out = strcmp(path, "-") ? fopen(path, "w") : stdout;
+	
+	if(out == NULL){
+		perror(path);
+		exit(1);
+	}
+	
+	/* no terminal, and saucer_hit and hits draw as the tick engine does */
+	game->headless = 1;
+	game->tick_engine = 1;
+	
+	/* the collision index for the tallest screen */
+	saucer_rows = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1][0] - 3;
+	spans_init();
+	
+	fprintf(out, "{\n  \"compiler\": \"%s\",\n  \"benchmarks\": [", 
+	    __VERSION__);
+	for(s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++){
+		for(n = 0; n < (int)(sizeof(counts) / sizeof(counts[0])); n++){
+			micro_setup(sizes[s][0], sizes[s][1], counts[n]);
+			micro_case(out, comma, "saucer_step", sizes[s][0], 
+			    sizes[s][1], micro_saucer, NULL);
+			comma = 1;
+			micro_case(out, comma, "shot_step", sizes[s][0], 
+			    sizes[s][1], micro_shot, NULL);
+			micro_setup(sizes[s][0], sizes[s][1], counts[n]);
+			micro_case(out, comma, "find_hit", sizes[s][0], 
+			    sizes[s][1], micro_find, micro_unkill);
+			micro_case(out, comma, "saucer_hit", sizes[s][0], 
+			    sizes[s][1], micro_hit, micro_unhit);
+			micro_case(out, comma, "stats", sizes[s][0], 
+			    sizes[s][1], micro_stats, NULL);
+		}
+	}
+	fprintf(out, "\n  ]\n}\n");
+	if(out != stdout){
+		fclose(out);
+	}
+}
+
+
+/*
+ * check_wheel puts a timer on a wheel for each of CHECKPERIODS, due that 
+ * many ticks ahead and again as many ticks after each time it comes due,
+ * and checks over CHECKTICKS ticks that each comes due at exactly its 
+ * tick, the times it should, whether or not it was cascaded down a level
+ * expects no args, returns the number of timers that did not
+ */
+int check_wheel(){
+	
+	static struct wheel w;
+	long periods[] = CHECKPERIODS;
+	int n = sizeof(periods) / sizeof(periods[0]);
+	struct timer t[sizeof(periods) / sizeof(periods[0])];
+	int fired[sizeof(periods) / sizeof(periods[0])];
+	int i, bad = 0;
+	long tick;
+	struct timer *due, *next;
+	
+	wheel_init(&w);
+	for(i = 0; i < n; i++){
+		t[i].prev = NULL;
+		t[i].owner = &periods[i];
+		fired[i] = 0;
+		wheel_at(&w, &t[i], periods[i]);
+	}
+	for(tick = 1; tick <= CHECKTICKS; tick++){
+		for(due = wheel_advance(&w); due != NULL; due = next){
+			next = due->next;
+			i = (long *)due->owner - periods;
+			if(due->due != tick || tick % periods[i] != 0){
+				printf("wheel: timer every %ld ticks due at "
+				    "%ld, came due at %ld\n", periods[i], 
+				    due->due, tick);
+				bad ++;
+			}
+			fired[i] ++;
+			wheel_at(&w, due, due->due + periods[i]);
+		}
+	}
+	for(i = 0; i < n; i++){
+		if(fired[i] != CHECKTICKS / periods[i]){
+			printf("wheel: timer every %ld ticks came due %d "
+			    "times, not %ld\n", periods[i], fired[i], 
+			    CHECKTICKS / periods[i]);
+			bad ++;
+		}
+	}
+	return bad;
+}
+
+
+/*
+ * check_headless plays each of CHECKRUNS with this program and checks it
+ * prints the numbers it always has. headless games are played from the 
+ * seed alone, so any change to how a game plays shows up here. -c is not
+ * checked, as its coroutines run in real time and never play the same 
+ * game twice
+ * expects no args, returns the number of runs that did not
+ */
+int check_headless(){
+	
+	static struct{
+		char *args;
+		char *label[2];
+		long want[2];
+	} runs[] = CHECKRUNS;
+	char self[PATH_MAX], cmd[PATH_MAX + 64], line[256], *at;
+	long got[2];
+	int i, k, n, bad = 0;
+	FILE *p;
+	
+	n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if(n < 0){
+		fprintf(stderr, "could not find this program to run it\n");
+		exit(-1);
+	}
+	self[n] = '\0';
+	for(i = 0; runs[i].args != NULL; i++){
+		snprintf(cmd, sizeof(cmd), "'%s' %s", self, runs[i].args);
+		p = popen(cmd, "r");
+		if(p == NULL){
+			fprintf(stderr, "could not run %s\n", cmd);
+			exit(-1);
+		}
+		got[0] = got[1] = -1;
+		while(fgets(line, sizeof(line), p) != NULL){
+			for(k = 0; k < 2; k++){
+				at = strstr(line, runs[i].label[k]);
+				if(at != NULL){
+					got[k] = atol(at + 
+					    strlen(runs[i].label[k]));
+				}
+			}
+		}
+		pclose(p);
+		if(got[0] != runs[i].want[0] || got[1] != runs[i].want[1]){
+			printf("saucer %s: %s%ld, %s%ld, not %ld and %ld\n", 
+			    runs[i].args, runs[i].label[0], got[0], 
+			    runs[i].label[1], got[1], runs[i].want[0], 
+			    runs[i].want[1]);
+			bad ++;
+		}
+	}
+	return bad;
+}
+
+
+/*
+ * self_check runs the checks of -C, printing what each finds
+ * expects no args, returns 0 if every check passed and 1 otherwise
+ */
+int self_check(){
+	
+	int wheel = check_wheel();
+	int headless;
+	
+	printf("timer wheel: %s\n", wheel ? "FAILED" : "ok");
+	fflush(stdout);
+	headless = check_headless();
+	printf("headless games: %s\n", headless ? "FAILED" : "ok");
+	return (wheel || headless) ? 1 : 0;
 }
 
 
@@ -0,0 +1,49 @@
+/*
+ * saucer.h declares the interface for playing saucer games from another
+ * program. build saucer.c with -DSAUCER_LIBRARY, which leaves out main,
+ * and link it with the program, -lcurses and -lpthread
+ *
+ * a batch is made with env_create, started with env_reset, then played
+ * a step of every game at a time with env_step. the games of a batch are
+ * headless and use the tick engine whatever else the process plays
+ *
+ * env_reset and env_step switch the calling thread to each game in turn,
+ * so a batch must only be played by one thread at a time. batches on 
+ * different threads are separate games, but every game in the process 
+ * shares the settings and machinery that are not part of a game: the 
+ * rows of saucers, rockets to start with and ticks a step (saucer_rows, 
+ * start_rockets, tick_scale), the worker pool, the key and draw queues, 
+ * the recording, and the replace, end and timer locks. set those before 
+ * making a batch and do not change them while one is played
+ */
+
+#ifndef SAUCER_H
+#define SAUCER_H
+
+/* actions taken in a game by env_step: nothing, or one of the player's */
+/* keys ',', '.' and ' '						 */
+#define ENV_NONE 0
+#define ENV_LEFT 1
+#define ENV_RIGHT 2
+#define ENV_FIRE 3
+
+struct game;
+
+/*
+ * a batch of headless games played by a program through env_reset and
+ * env_step, each a step at a time. an observation of a game is its screen,
+ * obs_size bytes, and score is each game's score at its last step
+ */
+struct env{
+	int n;
+	int obs_size;
+	struct game *games;
+	int *score;
+};
+
+struct env *env_create(int n, int rows, int cols);
+void env_reset(struct env *e, unsigned seed);
+void env_step(struct env *e, const int *actions, int n, char *obs,
+    int *rewards, char *dones);
+
+#endif